@@ -10,608 +10,4951 @@
 #include <cctype>
 #include <functional>
 #include <iomanip>
+#include <unordered_map>
+#include <unordered_set>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <cstdint>
+#include <array>
+#include <string_view>
+#include <memory>
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <charconv>
+#include <fcntl.h>
+#include <unistd.h>
+#include <list>
+#include <deque>
+#include <filesystem>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <csignal>
+#include <mutex>
+#include <new>
+#include <cstdlib>
+#include <cstddef>
+
+
+/** Mergeable approximate quantile sketch with bounded memory (KLL-style compactor hierarchy)
+ * Each level holds values of weight 2^level; when a level overflows, it is sorted and every other value is promoted
+ * Memory stays around 3*k values regardless of how many values are added, and rank error is roughly 1/k
+ * Sketches built over disjoint sets of values can be merged, so they can be built per thread or per file
+ **/
+class QuantileSketch
+{
+    private:
+        size_t k;
+        uint64_t total=0;
+        uint64_t coin=0x9E3779B97F4A7C15ULL;
+        std::vector<std::vector<double>> levels;
+
+        // Capacity of a level, shrinking geometrically for the lower (lighter) levels
+        size_t capacity(size_t level) const {
+            size_t depth = levels.size() - 1 - level;
+            double scaled = k * std::pow(2.0 / 3.0, static_cast<double>(depth));
+            return std::max<size_t>(2, static_cast<size_t>(std::ceil(scaled)));
+        }
+
+        // Sorts each overflowing level, lowest first, and promotes every other value (random offset) to the next level
+        void compress() {
+            for (size_t level = 0; level < levels.size(); ++level) {
+                if (levels[level].size() < capacity(level)) continue;
+                if (level + 1 == levels.size()) levels.emplace_back();
+
+                std::vector<double>& current = levels[level];
+                std::sort(current.begin(), current.end());
+                // Keep the last value on this level if the count is odd so weights stay exact
+                double leftover = 0.00;
+                bool hasLeftover = current.size() % 2 == 1;
+                if (hasLeftover) { leftover = current.back(); current.pop_back(); }
+
+                coin ^= coin << 13; coin ^= coin >> 7; coin ^= coin << 17;
+                for (size_t i = coin & 1; i < current.size(); i += 2) {
+                    levels[level + 1].push_back(current[i]);
+                }
+                current.clear();
+                if (hasLeftover) current.push_back(leftover);
+            }
+        }
+
+    public:
+        /** Constructor
+         * 'k' controls accuracy versus memory (rank error is roughly 1/k)
+         **/
+        QuantileSketch(size_t k=400) : k(std::max<size_t>(8, k)), levels(1) {}
+
+        void add(double value) {
+            levels[0].push_back(value);
+            total++;
+            if (levels[0].size() >= capacity(0)) compress();
+        }
+
+        /** Merges another sketch into this one
+         * The result summarizes the union of both value sets
+         **/
+        void merge(const QuantileSketch& other) {
+            if (other.levels.size() > levels.size()) levels.resize(other.levels.size());
+            for (size_t level = 0; level < other.levels.size(); ++level) {
+                levels[level].insert(levels[level].end(), other.levels[level].begin(), other.levels[level].end());
+            }
+            total += other.total;
+            // Compress repeatedly since a merge can overflow several levels at once
+            for (size_t level = 0; level < levels.size(); ++level) {
+                if (levels[level].size() >= capacity(level)) { compress(); level = static_cast<size_t>(-1); }
+            }
+        }
+
+        uint64_t count() const { return total; }
+
+        /** Returns the approximate value at percentile 'p' (0 to 100)
+         * Throws a runtime error if the sketch is empty
+         **/
+        double quantile(double p) const {
+            if (total == 0) {
+                throw std::runtime_error("Cannot compute a percentile of an empty set of users.");
+            }
+            std::vector<std::pair<double, uint64_t>> weighted;
+            uint64_t weightSum = 0;
+            for (size_t level = 0; level < levels.size(); ++level) {
+                for (double value : levels[level]) {
+                    weighted.push_back({value, uint64_t(1) << level});
+                    weightSum += uint64_t(1) << level;
+                }
+            }
+            std::sort(weighted.begin(), weighted.end());
+            double target = std::clamp(p, 0.0, 100.0) / 100.0 * weightSum;
+            uint64_t running = 0;
+            for (const auto& entry : weighted) {
+                running += entry.second;
+                if (running >= target) return entry.first;
+            }
+            return weighted.back().first;
+        }
+};
+
+
+/** Flushes a file or directory to the disk
+ * Throws a runtime error if it cannot be opened or synced
+ **/
+inline void syncPath(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open " + path + ": " + std::strerror(errno));
+    }
+    int result = ::fsync(fd);
+    int error = errno;
+    ::close(fd);
+    if (result != 0) {
+        throw std::runtime_error("Could not sync " + path + ": " + std::strerror(error));
+    }
+}
+
+/** Replaces 'target' with the fully written file 'temporary'
+ * The temporary file is synced before the rename and the directory after it, so after a crash the target is either the old or the new file
+ * Throws a runtime error if a sync or the rename fails
+ **/
+inline void replaceFile(const std::string& temporary, const std::string& target) {
+    syncPath(temporary);
+    if (std::rename(temporary.c_str(), target.c_str()) != 0) {
+        throw std::runtime_error("Could not replace " + target + ": " + std::strerror(errno));
+    }
+    std::filesystem::path directory = std::filesystem::path(target).parent_path();
+    syncPath(directory.empty() ? "." : directory.string());
+}
+
+
+/** Append-only write-ahead journal of user mutations
+ * Records are single text lines, buffered in memory and written with one write and one fdatasync per group (group commit)
+ * A record is durable once commit() returns, or once 'groupSize' records have been appended since the last commit
+ **/
+class MutationJournal
+{
+    private:
+        int fd=-1;
+        std::string path;
+        std::string buffer;
+        size_t groupSize;
+        size_t pending=0;
+        size_t recordsSinceSnapshot=0;
+
+    public:
+        /** Constructor
+         * Opens (or creates) the journal file for appending
+         * Throws a runtime error if the file cannot be opened
+         **/
+        MutationJournal(const std::string& path, size_t groupSize) : path(path), groupSize(std::max<size_t>(1, groupSize)) {
+            fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+            if (fd < 0) {
+                throw std::runtime_error("Could not open journal " + path + ": " + std::strerror(errno));
+            }
+        }
+
+        /** Destructor
+         * Commits any buffered records before closing the file
+         **/
+        ~MutationJournal() {
+            try { commit(); } catch (const std::exception&) {}
+            ::close(fd);
+        }
+
+        MutationJournal(const MutationJournal&) = delete;
+        MutationJournal& operator=(const MutationJournal&) = delete;
+
+        /** Appends one record (without its trailing newline) and commits the group once it is full
+         **/
+        void append(const std::string& record) {
+            buffer += record;
+            buffer += '\n';
+            pending++;
+            recordsSinceSnapshot++;
+            if (pending >= groupSize) commit();
+        }
+
+        /** Writes all buffered records and waits for them to reach the disk
+         * Throws a runtime error if the write or sync fails
+         **/
+        void commit() {
+            if (buffer.empty()) return;
+            size_t written = 0;
+            while (written < buffer.size()) {
+                ssize_t result = ::write(fd, buffer.data() + written, buffer.size() - written);
+                if (result < 0) {
+                    if (errno == EINTR) continue;
+                    throw std::runtime_error("Could not write journal " + path + ": " + std::strerror(errno));
+                }
+                written += result;
+            }
+            if (::fdatasync(fd) != 0) {
+                throw std::runtime_error("Could not sync journal " + path + ": " + std::strerror(errno));
+            }
+            buffer.clear();
+            pending = 0;
+        }
+
+        /** Discards all journaled records once they are covered by a fresh snapshot
+         **/
+        void truncate() {
+            buffer.clear();
+            pending = 0;
+            recordsSinceSnapshot = 0;
+            if (::ftruncate(fd, 0) != 0 || ::fdatasync(fd) != 0) {
+                throw std::runtime_error("Could not truncate journal " + path + ": " + std::strerror(errno));
+            }
+        }
+
+        size_t recordCount() const { return recordsSinceSnapshot; }
+};
+
+
+/** A filter on the categorical columns and age of a user
+ * Empty lists and the default age limits match every user; a user must satisfy every non-empty condition
+ * 'groups' tests the bfp group column (e.g. "normal", "very high", "healthy weight")
+ **/
+struct ScanFilter
+{
+    std::vector<std::string> genders;
+    int minAge=std::numeric_limits<int>::min();
+    int maxAge=std::numeric_limits<int>::max();
+    std::vector<std::string> lifestyles;
+    std::vector<std::string> groups;
+
+    // Columns of the .csv file (see UserInfoManager::csvColumns) the filter needs to read
+    uint32_t columns() const {
+        uint32_t mask = 0;
+        if (!genders.empty()) mask |= 1u << 1;
+        if (minAge != std::numeric_limits<int>::min() || maxAge != std::numeric_limits<int>::max()) mask |= 1u << 2;
+        if (!groups.empty()) mask |= 1u << 9;
+        if (!lifestyles.empty()) mask |= 1u << 14;
+        return mask;
+    }
+
+    /** Checks the filter against a user's gender, age, lifestyle and bfp group
+     * Takes views so rows can be tested while scanning a file, before anything is copied
+     **/
+    bool matches(std::string_view gender, int age, std::string_view lifestyle, std::string_view group) const {
+        auto listed = [](const std::vector<std::string>& values, std::string_view value) {
+            return values.empty() || std::find(values.begin(), values.end(), value) != values.end();
+        };
+        return age >= minAge && age <= maxAge && listed(genders, gender) && listed(lifestyles, lifestyle) && listed(groups, group);
+    }
+};
+
+
+/** Mixes one 64-bit word into a running fingerprint hash (multiply by the 64-bit golden ratio, then fold the high half down)
+ * Fingerprints are persisted, so the hash is spelled out rather than left to std::hash
+ **/
+inline uint64_t fingerprintMix(uint64_t hash, uint64_t word) {
+    hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+    return hash ^ (hash >> 32);
+}
+
+inline uint64_t fingerprintMix(uint64_t hash, double value) {
+    uint64_t word;
+    std::memcpy(&word, &value, sizeof(word));
+    return fingerprintMix(hash, word);
+}
+
+
+/** Body fat percentage group thresholds of the US Navy and BMI methods, compiled into lookup tables
+ * The defaults are the thresholds the methods have always used; load() replaces them from a config file at runtime
+ * Config lines are "USNavy,<female|male>,<20-39|40-59|60-79>,<low>,<normal>,<high>" with the upper limits of the low,
+ * normal and high groups, or "bmi,<underweight>,<healthy weight>,<overweight>" likewise; '#' starts a comment
+ * Lines left out of the file keep their current thresholds
+ **/
+class BfpThresholds
+{
+    public:
+
+        BfpThresholds() {
+            usNavyLimits = {{ {21, 33, 39}, {23, 34, 40}, {24, 36, 42}, {8, 20, 25}, {11, 22, 28}, {13, 25, 30} }};
+            bmiLimits = {18.5, 24.9, 29.9};
+            compile();
+        }
+
+        /** The thresholds used when a bfp is calculated
+         **/
+        static BfpThresholds& current() {
+            static BfpThresholds thresholds;
+            return thresholds;
+        }
+
+        /** Replaces the thresholds with those of a config file (see the class comment)
+         * Throws a runtime error if the file cannot be opened and an invalid argument error if a line is malformed
+         * or its limits are not ascending; the thresholds are left unchanged on error
+         **/
+        void load(const std::string& filename) {
+            std::ifstream file(filename);
+            if (!file.is_open()) {
+                throw std::runtime_error("Could not open file " + filename);
+            }
+            BfpThresholds loaded = *this;
+            std::string line;
+            while (std::getline(file, line)) {
+                line = line.substr(0, line.find('#'));
+                if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+                std::vector<std::string> fields;
+                std::istringstream iss(line);
+                std::string field;
+                while (std::getline(iss, field, ',')) fields.push_back(field);
+
+                std::array<double, 3>* limits = nullptr;
+                if (fields.size() == 6 && fields[0] == "USNavy") {
+                    int sex = (fields[1] == "female") ? 0 : (fields[1] == "male") ? 1 : -1;
+                    int band = (fields[2] == "20-39") ? 0 : (fields[2] == "40-59") ? 1 : (fields[2] == "60-79") ? 2 : -1;
+                    if (sex >= 0 && band >= 0) limits = &loaded.usNavyLimits[sex * 3 + band];
+                } else if (fields.size() == 4 && fields[0] == "bmi") {
+                    limits = &loaded.bmiLimits;
+                }
+                if (!limits) throw std::invalid_argument("Invalid threshold line: " + line);
+                for (size_t i = 0; i < 3; ++i) {
+                    (*limits)[i] = std::stod(fields[fields.size() - 3 + i]);
+                }
+                if (!((*limits)[0] <= (*limits)[1] && (*limits)[1] <= (*limits)[2])) {
+                    throw std::invalid_argument("Thresholds must be ascending: " + line);
+                }
+            }
+            loaded.compile();
+            *this = loaded;
+        }
+
+        /** Returns the US Navy group of a bfp for an age and gender code (0 female, 1 male, 2 unknown)
+         * Users under 20, females over 79 and users of unknown gender are always "very high", as they always were
+         **/
+        const std::string& usNavyGroup(double bfp, int age, uint8_t genderCode) const {
+            return usNavyGroups[usNavyBucket(bfp, age, genderCode)];
+        }
+
+        const std::string& usNavyGroup(double bfp, int age, const std::string& gender) const {
+            return usNavyGroup(bfp, age, (gender == "female") ? 0 : (gender == "male") ? 1 : 2);
+        }
+
+        /** Returns the BMI group of a bfp
+         **/
+        const std::string& bmiGroup(double bfp) const {
+            return bmiGroups[bmiBucket(bfp)];
+        }
+
+        /** Return the position of a bfp's group among the groups of its method, from 0 (lowest) to 3 (highest)
+         **/
+        int usNavyBucket(double bfp, int age, uint8_t genderCode) const {
+            int row = usNavyRows[std::min<uint8_t>(genderCode, 2)][std::clamp(age, -1, maxAge) + 1];
+            return row < 0 ? 3 : bucket(usNavyLimits[row], bfp);
+        }
+        int bmiBucket(double bfp) const { return bucket(bmiLimits, bfp); }
+
+        static const std::string& usNavyGroupName(int position) { return usNavyGroups[position]; }
+        static const std::string& bmiGroupName(int position) { return bmiGroups[position]; }
+
+    private:
+
+        // Ages covered by the age table; older users share its last entry
+        static constexpr int maxAge = 127;
+
+        inline static const std::string usNavyGroups[4] = { "low", "normal", "high", "very high" };
+        inline static const std::string bmiGroups[4] = { "underweight", "healthy weight", "overweight", "obesity" };
+
+        // Upper limits of the three lower groups, for females then males, aged 20-39, 40-59 and 60-79
+        std::array<std::array<double, 3>, 6> usNavyLimits;
+        std::array<double, 3> bmiLimits;
+
+        // Row of 'usNavyLimits' for each gender code and age (offset by one, so -1 maps below 0), or -1 for "very high"
+        std::array<std::array<int8_t, maxAge + 2>, 3> usNavyRows;
+
+        /** Fills the age table from the age bands; males over 79 keep the 60-79 thresholds
+         **/
+        void compile() {
+            for (int sex = 0; sex < 3; ++sex) {
+                for (int age = -1; age <= maxAge; ++age) {
+                    int band = (age >= 20 && age <= 39) ? 0 : (age >= 40 && age <= 59) ? 1 : (age >= 60 && (age <= 79 || sex == 1)) ? 2 : -1;
+                    usNavyRows[sex][age + 1] = (sex < 2 && band >= 0) ? sex * 3 + band : -1;
+                }
+            }
+        }
+
+        /** Returns the group of a bfp as the number of limits it is not below, without branches
+         * Counts comparisons that fail rather than succeed, so a bfp that is not a number falls in the top group
+         **/
+        static int bucket(const std::array<double, 3>& limits, double bfp) {
+            return 3 - (bfp < limits[0]) - (bfp < limits[1]) - (bfp < limits[2]);
+        }
+};
+
+
+/** Bounded lock-free queue between exactly one producer thread and one consumer thread
+ * push waits while the queue is full (backpressure) and pop waits while it is empty; neither takes a lock
+ * The counters tell how full the queue ran and how often each side had to wait for the other
+ **/
+template <typename T>
+class SpscRing
+{
+    private:
+        std::vector<T> slots;
+        size_t mask;
+        alignas(64) std::atomic<size_t> head{0};
+        alignas(64) std::atomic<size_t> tail{0};
+        alignas(64) std::atomic<bool> closed{false};
+
+        // Written by the producer only
+        alignas(64) size_t fullWaits=0;
+        // Written by the consumer only
+        alignas(64) size_t emptyWaits=0;
+        size_t popped=0;
+        size_t occupancySum=0;
+
+    public:
+        /** Constructor
+         * The capacity is rounded up to a power of two
+         **/
+        explicit SpscRing(size_t capacity) {
+            size_t size = 1;
+            while (size < capacity) size <<= 1;
+            slots.resize(size);
+            mask = size - 1;
+        }
+
+        SpscRing(const SpscRing&) = delete;
+        SpscRing& operator=(const SpscRing&) = delete;
+
+        /** Moves 'value' into the queue, waiting while the queue is full
+         * Producer side only
+         **/
+        void push(T&& value) {
+            size_t position = tail.load(std::memory_order_relaxed);
+            if (position - head.load(std::memory_order_acquire) > mask) {
+                fullWaits++;
+                while (position - head.load(std::memory_order_acquire) > mask) std::this_thread::yield();
+            }
+            slots[position & mask] = std::move(value);
+            tail.store(position + 1, std::memory_order_release);
+        }
+
+        /** Tells the consumer that nothing more will be pushed
+         * Producer side only
+         **/
+        void close() { closed.store(true, std::memory_order_release); }
+
+        /** Moves the oldest value out of the queue into 'value', waiting while the queue is empty
+         * Returns false once the queue is closed and drained
+         * Consumer side only
+         **/
+        bool pop(T& value) {
+            size_t position = head.load(std::memory_order_relaxed);
+            size_t available = tail.load(std::memory_order_acquire) - position;
+            if (available == 0) {
+                emptyWaits++;
+                while ((available = tail.load(std::memory_order_acquire) - position) == 0) {
+                    if (closed.load(std::memory_order_acquire)) {
+                        // Values pushed before close() are visible once 'closed' is
+                        if ((available = tail.load(std::memory_order_acquire) - position) == 0) return false;
+                        break;
+                    }
+                    std::this_thread::yield();
+                }
+            }
+            value = std::move(slots[position & mask]);
+            head.store(position + 1, std::memory_order_release);
+            popped++;
+            occupancySum += available;
+            return true;
+        }
+
+        /** Queue counters, to be read once both sides are done
+         * 'averageOccupancy' is the mean number of queued values seen by the consumer, out of 'capacity'
+         **/
+        struct Metrics {
+            size_t capacity;
+            size_t values;
+            double averageOccupancy;
+            size_t fullWaits;
+            size_t emptyWaits;
+        };
+
+        Metrics metrics() const {
+            return { slots.size(), popped, popped ? static_cast<double>(occupancySum) / popped : 0.0, fullWaits, emptyWaits };
+        }
+};
+
+
+/** Latency histogram with HDR-style log-linear buckets
+ * Values (in nanoseconds) below 256 get a bucket each; above that every power of two is split into 128 buckets,
+ * so any recorded value is reported within 1% of its true value, whatever its magnitude
+ * Histograms of the same operation from different threads can be merged exactly
+ **/
+class LatencyHistogram
+{
+    public:
+        static constexpr int subBits = 7;
+        static constexpr uint64_t subCount = uint64_t(1) << subBits;
+        // Values are clamped to 2^36 ns (about 68 seconds)
+        static constexpr uint64_t maxValue = (uint64_t(1) << 36) - 1;
+        static constexpr size_t bucketCount = (36 - subBits + 1) * subCount;
+
+        // Bucket holding a value
+        static size_t bucketOf(uint64_t value) {
+            value = std::min(value, maxValue);
+            if (value < 2 * subCount) return value;
+            int magnitude = 63 - __builtin_clzll(value);
+            int shift = magnitude - subBits;
+            return (shift + 1) * subCount + ((value >> shift) - subCount);
+        }
+
+        // Middle of the range of values held by a bucket
+        static uint64_t valueOf(size_t bucket) {
+            if (bucket < 2 * subCount) return bucket;
+            int shift = bucket / subCount - 1;
+            return ((bucket % subCount + subCount) << shift) + (uint64_t(1) << (shift - 1));
+        }
+
+        std::vector<uint64_t> counts=std::vector<uint64_t>(bucketCount, 0);
+        uint64_t total=0;
+        uint64_t max=0;
+
+        void record(uint64_t nanoseconds) {
+            counts[bucketOf(nanoseconds)]++;
+            total++;
+            max = std::max(max, nanoseconds);
+        }
+
+        void merge(const LatencyHistogram& other) {
+            for (size_t i = 0; i < bucketCount; ++i) counts[i] += other.counts[i];
+            total += other.total;
+            max = std::max(max, other.max);
+        }
+
+        /** Returns the value at or below which a fraction 'p' of the recorded values lie, in nanoseconds
+         * Returns 0 for an empty histogram
+         **/
+        uint64_t percentile(double p) const {
+            if (total == 0) return 0;
+            uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(std::clamp(p, 0.0, 1.0) * total)));
+            uint64_t seen = 0;
+            for (size_t i = 0; i < bucketCount; ++i) {
+                seen += counts[i];
+                if (seen >= rank) return std::min(valueOf(i), max);
+            }
+            return max;
+        }
+};
+
+
+/** Opt-in recorder of per-operation latencies
+ * Each thread records into its own histograms without locking; a lock is only taken the first time
+ * a thread records an operation and when the histograms are merged for a report
+ * While disabled, timing an operation costs a single relaxed atomic load
+ **/
+class LatencyRecorder
+{
+    private:
+        // One operation's histogram in one thread; buckets are atomic only so a report can read them while the thread records
+        struct ThreadHistogram {
+            std::string operation;
+            std::unique_ptr<std::atomic<uint64_t>[]> counts{new std::atomic<uint64_t>[LatencyHistogram::bucketCount]()};
+            std::atomic<uint64_t> max{0};
+        };
+
+        inline static std::atomic<bool> enabled{false};
+        inline static std::mutex registryLock;
+        // Every histogram ever created, kept after their thread exits so short-lived threads are still reported
+        inline static std::vector<std::unique_ptr<ThreadHistogram>> registry;
+
+        static ThreadHistogram& histogramFor(const char* operation) {
+            thread_local std::unordered_map<const char*, ThreadHistogram*> histograms;
+            ThreadHistogram*& histogram = histograms[operation];
+            if (!histogram) {
+                std::lock_guard<std::mutex> guard(registryLock);
+                registry.push_back(std::make_unique<ThreadHistogram>());
+                registry.back()->operation = operation;
+                histogram = registry.back().get();
+            }
+            return *histogram;
+        }
+
+    public:
+        static void enable(bool on) { enabled.store(on, std::memory_order_relaxed); }
+        static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+        // Records one latency of an operation in the calling thread's histogram
+        static void record(const char* operation, uint64_t nanoseconds) {
+            ThreadHistogram& histogram = histogramFor(operation);
+            histogram.counts[LatencyHistogram::bucketOf(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+            if (nanoseconds > histogram.max.load(std::memory_order_relaxed)) histogram.max.store(nanoseconds, std::memory_order_relaxed);
+        }
+
+        /** Merges the histograms of all threads, one per operation, sorted by operation name
+         **/
+        static std::vector<std::pair<std::string, LatencyHistogram>> merged() {
+            std::vector<std::pair<std::string, LatencyHistogram>> operations;
+            std::lock_guard<std::mutex> guard(registryLock);
+            for (const auto& histogram : registry) {
+                auto same = std::find_if(operations.begin(), operations.end(), [&](const auto& entry) { return entry.first == histogram->operation; });
+                if (same == operations.end()) same = operations.insert(operations.end(), { histogram->operation, LatencyHistogram() });
+                LatencyHistogram& target = same->second;
+                for (size_t i = 0; i < LatencyHistogram::bucketCount; ++i) {
+                    uint64_t count = histogram->counts[i].load(std::memory_order_relaxed);
+                    target.counts[i] += count;
+                    target.total += count;
+                }
+                target.max = std::max(target.max, histogram->max.load(std::memory_order_relaxed));
+            }
+            std::sort(operations.begin(), operations.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+            return operations;
+        }
+
+        /** Clears all recorded latencies
+         **/
+        static void reset() {
+            std::lock_guard<std::mutex> guard(registryLock);
+            for (const auto& histogram : registry) {
+                for (size_t i = 0; i < LatencyHistogram::bucketCount; ++i) histogram->counts[i].store(0, std::memory_order_relaxed);
+                histogram->max.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        /** Writes one line per recorded operation with its count and p50/p90/p99/p99.9/max latencies in microseconds
+         **/
+        static void report(std::ostream& out) {
+            // Leave the caller's stream formatted as it was
+            std::ios::fmtflags flags = out.flags();
+            std::streamsize precision = out.precision();
+            out << std::left << std::setw(22) << "operation" << std::right << std::setw(10) << "count" << std::setw(11) << "p50" << std::setw(11) << "p90"
+                << std::setw(11) << "p99" << std::setw(11) << "p99.9" << std::setw(11) << "max" << "  (us)\n";
+            for (const auto& [operation, histogram] : merged()) {
+                if (histogram.total == 0) continue;
+                out << std::left << std::setw(22) << operation << std::right << std::setw(10) << histogram.total << std::fixed << std::setprecision(2);
+                for (double p : { 0.5, 0.9, 0.99, 0.999 }) out << std::setw(11) << histogram.percentile(p) / 1000.0;
+                out << std::setw(11) << histogram.max / 1000.0 << "\n";
+            }
+            out.flags(flags);
+            out.precision(precision);
+        }
+};
+
+
+/** Opt-in recorder of timed spans, written out as Chrome trace-event JSON (viewable in chrome://tracing or Perfetto)
+ * Each thread appends spans to its own fixed-size buffer without locking; a lock is only taken the first time a thread records
+ * Spans that do not fit in a thread's buffer are counted as dropped rather than blocking or allocating
+ **/
+class TraceRecorder
+{
+    private:
+        struct Span {
+            const char* name;
+            const char* category;
+            int64_t start;
+            int64_t duration;
+        };
+
+        struct ThreadBuffer {
+            static constexpr size_t capacity = 1 << 16;
+            std::unique_ptr<Span[]> spans{new Span[capacity]};
+            // Number of complete spans; published with release so a writer of the trace sees whole spans only
+            std::atomic<size_t> count{0};
+            std::atomic<size_t> dropped{0};
+            int thread;
+        };
+
+        inline static std::atomic<bool> enabled{false};
+        inline static std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+        inline static std::mutex registryLock;
+        inline static std::vector<std::unique_ptr<ThreadBuffer>> registry;
+        // Buffers of exited threads, handed to new threads so short-lived worker threads share a few tracks
+        inline static std::vector<ThreadBuffer*> released;
+
+        // Gives the calling thread a buffer on first use, and releases it when the thread exits
+        struct BufferOwner {
+            ThreadBuffer* buffer=nullptr;
+            ~BufferOwner() {
+                if (!buffer) return;
+                std::lock_guard<std::mutex> guard(registryLock);
+                released.push_back(buffer);
+            }
+        };
+
+        static ThreadBuffer& bufferForThread() {
+            thread_local BufferOwner owner;
+            if (!owner.buffer) {
+                std::lock_guard<std::mutex> guard(registryLock);
+                if (!released.empty()) {
+                    owner.buffer = released.back();
+                    released.pop_back();
+                } else {
+                    registry.push_back(std::make_unique<ThreadBuffer>());
+                    owner.buffer = registry.back().get();
+                    owner.buffer->thread = registry.size();
+                }
+            }
+            return *owner.buffer;
+        }
+
+    public:
+        static void enable(bool on) { enabled.store(on, std::memory_order_relaxed); }
+        static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+        // Nanoseconds since the recorder was set up, the time base of all spans
+        static int64_t now() { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count(); }
+
+        // Records one span in the calling thread's buffer; 'name' and 'category' must be string literals
+        static void record(const char* name, const char* category, int64_t start, int64_t end) {
+            ThreadBuffer& buffer = bufferForThread();
+            size_t position = buffer.count.load(std::memory_order_relaxed);
+            if (position == ThreadBuffer::capacity) {
+                buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            buffer.spans[position] = Span{ name, category, start, end - start };
+            buffer.count.store(position + 1, std::memory_order_release);
+        }
+
+        /** Writes every recorded span as a complete ("X") trace event, with one named track per thread
+         * Throws a runtime error if the file cannot be written
+         **/
+        static void write(const std::string& filename) {
+            std::ofstream file(filename);
+            if (!file) {
+                throw std::runtime_error("Could not open file " + filename);
+            }
+            std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+            char event[256];
+            bool first = true;
+            std::lock_guard<std::mutex> guard(registryLock);
+            for (const auto& buffer : registry) {
+                size_t dropped = buffer->dropped.load(std::memory_order_relaxed);
+                out.append(event, std::snprintf(event, sizeof(event), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d%s\"}}",
+                    first ? "" : ",\n", buffer->thread, buffer->thread, dropped ? " (spans dropped)" : ""));
+                first = false;
+                size_t count = buffer->count.load(std::memory_order_acquire);
+                for (size_t i = 0; i < count; ++i) {
+                    const Span& span = buffer->spans[i];
+                    out.append(event, std::snprintf(event, sizeof(event), ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                        span.name, span.category, buffer->thread, span.start / 1000.0, span.duration / 1000.0));
+                }
+            }
+            out += "\n]}\n";
+            file << out;
+            if (!file) {
+                throw std::runtime_error("Could not write file " + filename);
+            }
+        }
+
+        /** Discards all recorded spans
+         **/
+        static void reset() {
+            std::lock_guard<std::mutex> guard(registryLock);
+            for (const auto& buffer : registry) {
+                buffer->count.store(0, std::memory_order_relaxed);
+                buffer->dropped.store(0, std::memory_order_relaxed);
+            }
+        }
+};
+
+
+/** Records the enclosing scope as a trace span, if tracing is enabled
+ * 'name' and 'category' must be string literals
+ **/
+class TraceSpan
+{
+    private:
+        const char* name;
+        const char* category;
+        int64_t start=0;
+
+    public:
+        TraceSpan(const char* name, const char* category) : name(TraceRecorder::isEnabled() ? name : nullptr), category(category) {
+            if (this->name) start = TraceRecorder::now();
+        }
+
+        ~TraceSpan() {
+            if (name) TraceRecorder::record(name, category, start, TraceRecorder::now());
+        }
+
+        TraceSpan(const TraceSpan&) = delete;
+        TraceSpan& operator=(const TraceSpan&) = delete;
+};
+
+
+/** Opt-in accounting of heap allocations by phase
+ * The global operator new and delete below report every allocation and free here while tracking is enabled
+ * Each thread attributes its allocations to its innermost open phase (see AllocationPhase); phase 0 collects the rest
+ * Bytes are counted as requested; every block carries a header naming the tracking session it was allocated in,
+ * so only blocks allocated since tracking was enabled (or reset) count when freed, and live bytes never go below zero
+ * A phase's peak is the most live bytes seen by an allocation made in that phase
+ **/
+class AllocationTracker
+{
+    public:
+        // Only held in the static 'phases' table, so its counters start zeroed
+        struct Phase {
+            std::atomic<const char*> name;
+            std::atomic<uint64_t> allocations;
+            std::atomic<uint64_t> frees;
+            std::atomic<uint64_t> bytes;
+            std::atomic<int64_t> peak;
+        };
+
+        /** Placed in front of every block from the global operator new
+         * 'session' is the tracking session the block was allocated in, or 0 if tracking was off
+         * Its alignment keeps the block behind it aligned for any type
+         **/
+        struct alignas(alignof(std::max_align_t)) Header {
+            size_t size;
+            uint64_t session;
+        };
+
+        static constexpr size_t maxPhases = 128;
+
+    private:
+        // The current tracking session, or 0 while tracking is off; each enable or reset starts a new one
+        inline static std::atomic<uint64_t> session{0};
+        inline static std::atomic<uint64_t> sessions{0};
+        inline static std::atomic<int64_t> live{0};
+        inline static Phase phases[maxPhases];
+        inline static std::atomic<size_t> phaseCount{1};
+        inline static std::mutex registryLock;
+        inline static thread_local size_t current = 0;
+
+    public:
+        static void enable(bool on) { session.store(on ? sessions.fetch_add(1, std::memory_order_relaxed) + 1 : 0, std::memory_order_relaxed); }
+        static bool isEnabled() { return session.load(std::memory_order_relaxed) != 0; }
+
+        /** Returns the phase with the given name, registering it on first use
+         * Phases beyond 'maxPhases' share the last one
+         **/
+        static size_t phaseOf(const char* name) {
+            auto find = [name] {
+                size_t count = phaseCount.load(std::memory_order_acquire);
+                for (size_t phase = 1; phase < count; ++phase) {
+                    const char* other = phases[phase].name.load(std::memory_order_relaxed);
+                    if (other == name || std::strcmp(other, name) == 0) return phase;
+                }
+                return size_t(0);
+            };
+            if (size_t phase = find()) return phase;
+            std::lock_guard<std::mutex> guard(registryLock);
+            if (size_t phase = find()) return phase;
+            size_t phase = phaseCount.load(std::memory_order_relaxed);
+            if (phase == maxPhases) return maxPhases - 1;
+            phases[phase].name.store(name, std::memory_order_relaxed);
+            phaseCount.store(phase + 1, std::memory_order_release);
+            return phase;
+        }
+
+        // Makes 'phase' the calling thread's current phase and returns the previous one
+        static size_t enter(size_t phase) {
+            size_t previous = current;
+            current = phase;
+            return previous;
+        }
+
+        static size_t currentPhase() { return current; }
+
+        /** Fills the header of a block from malloc with room for 'size' bytes, and counts it if tracking is enabled
+         * Returns the memory behind the header
+         **/
+        static void* allocated(void* block, size_t size) {
+            Header* header = static_cast<Header*>(block);
+            header->size = size;
+            header->session = session.load(std::memory_order_relaxed);
+            if (header->session != 0) count(size);
+            return header + 1;
+        }
+
+        /** Counts the free of memory returned by allocated, if it was allocated in the current session
+         * Returns the block to give back to free
+         **/
+        static void* freed(void* pointer) {
+            Header* header = static_cast<Header*>(pointer) - 1;
+            if (header->session != 0 && header->session == session.load(std::memory_order_relaxed)) {
+                live.fetch_sub(header->size, std::memory_order_relaxed);
+                phases[current].frees.fetch_add(1, std::memory_order_relaxed);
+            }
+            return header;
+        }
+
+    private:
+        static void count(int64_t size) {
+            int64_t now = live.fetch_add(size, std::memory_order_relaxed) + size;
+            Phase& phase = phases[current];
+            phase.allocations.fetch_add(1, std::memory_order_relaxed);
+            phase.bytes.fetch_add(size, std::memory_order_relaxed);
+            int64_t peak = phase.peak.load(std::memory_order_relaxed);
+            while (now > peak && !phase.peak.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {}
+        }
+
+    public:
+        /** Clears all counters, keeping the registered phases
+         * Blocks allocated before the reset no longer count when freed
+         **/
+        static void reset() {
+            if (isEnabled()) enable(true);
+            live.store(0, std::memory_order_relaxed);
+            for (Phase& phase : phases) {
+                phase.allocations.store(0, std::memory_order_relaxed);
+                phase.frees.store(0, std::memory_order_relaxed);
+                phase.bytes.store(0, std::memory_order_relaxed);
+                phase.peak.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        /** Writes one line per phase with its allocations, frees, bytes allocated and peak live bytes
+         * Phases without allocations are listed too, so zero-allocation phases are visible
+         **/
+        static void report(std::ostream& out) {
+            out << std::left << std::setw(22) << "phase" << std::right << std::setw(14) << "allocations" << std::setw(14) << "frees"
+                << std::setw(16) << "bytes" << std::setw(16) << "peak live" << "\n";
+            size_t count = phaseCount.load(std::memory_order_acquire);
+            for (size_t phase = 0; phase < count; ++phase) {
+                const char* name = phase ? phases[phase].name.load(std::memory_order_relaxed) : "(no phase)";
+                out << std::left << std::setw(22) << name << std::right << std::setw(14) << phases[phase].allocations.load()
+                    << std::setw(14) << phases[phase].frees.load() << std::setw(16) << phases[phase].bytes.load()
+                    << std::setw(16) << phases[phase].peak.load() << "\n";
+            }
+        }
+};
+
+
+/** Attributes the calling thread's allocations in the enclosing scope to a phase, if allocation tracking is enabled
+ * 'name' must be a string literal; a phase index (e.g. AllocationTracker::currentPhase() of another thread) may be given instead
+ **/
+class AllocationPhase
+{
+    private:
+        bool active;
+        size_t previous=0;
+
+    public:
+        explicit AllocationPhase(const char* name) : active(AllocationTracker::isEnabled()) {
+            if (active) previous = AllocationTracker::enter(AllocationTracker::phaseOf(name));
+        }
+
+        explicit AllocationPhase(size_t phase) : active(AllocationTracker::isEnabled()) {
+            if (active) previous = AllocationTracker::enter(phase);
+        }
+
+        ~AllocationPhase() {
+            if (active) AllocationTracker::enter(previous);
+        }
+
+        AllocationPhase(const AllocationPhase&) = delete;
+        AllocationPhase& operator=(const AllocationPhase&) = delete;
+};
+
+
+// Global allocation functions that put an AllocationTracker header in front of every block and report to it while tracking is enabled
+void* operator new(std::size_t size) {
+    void* block = std::malloc(sizeof(AllocationTracker::Header) + size);
+    if (!block) throw std::bad_alloc();
+    return AllocationTracker::allocated(block, size);
+}
+
+void* operator new[](std::size_t size) { return operator new(size); }
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    void* block = std::malloc(sizeof(AllocationTracker::Header) + size);
+    return block ? AllocationTracker::allocated(block, size) : nullptr;
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept { return operator new(size, tag); }
+
+void operator delete(void* pointer) noexcept {
+    if (!pointer) return;
+    std::free(AllocationTracker::freed(pointer));
+}
+
+void operator delete[](void* pointer) noexcept { operator delete(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept { operator delete(pointer); }
+void operator delete[](void* pointer, std::size_t) noexcept { operator delete(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { operator delete(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { operator delete(pointer); }
+
+
+/** Records the latency of the enclosing scope as one call of an operation, if latency recording is enabled
+ * Also records the scope as an "operation" trace span if tracing is enabled (see TraceRecorder),
+ * and attributes its allocations to a phase named after the operation if allocation tracking is enabled
+ * 'operation' must be a string literal
+ **/
+class LatencyTimer
+{
+    private:
+        const char* operation;
+        bool latency;
+        bool trace;
+        int64_t start=0;
+        AllocationPhase phase;
+
+    public:
+        explicit LatencyTimer(const char* operation)
+            : operation(operation), latency(LatencyRecorder::isEnabled()), trace(TraceRecorder::isEnabled()), phase(operation) {
+            if (latency || trace) start = TraceRecorder::now();
+        }
+
+        ~LatencyTimer() {
+            if (!latency && !trace) return;
+            int64_t end = TraceRecorder::now();
+            if (latency) LatencyRecorder::record(operation, static_cast<uint64_t>(end - start));
+            if (trace) TraceRecorder::record(operation, "operation", start, end);
+        }
+
+        LatencyTimer(const LatencyTimer&) = delete;
+        LatencyTimer& operator=(const LatencyTimer&) = delete;
+};
+
+
+/** Bump-pointer storage for strings that live as long as their owner, e.g. the user names of a UserInfoManager
+ * Strings are copied into large blocks and referenced by block, offset and length; blocks never move, so views stay valid
+ * reset() forgets every string in O(1) and reuses the blocks already allocated
+ **/
+class NameArena
+{
+    public:
+        struct Ref {
+            uint32_t block=0;
+            uint32_t offset=0;
+            uint32_t length=0;
+        };
+
+    private:
+        static constexpr size_t blockSize = 1 << 20;
+        std::vector<std::unique_ptr<char[]>> blocks;
+        std::vector<size_t> sizes;
+        // Bytes in use at the start of each block
+        std::vector<size_t> filled;
+        size_t current=0;
+        // Blocks passed over with room left, tried before the arena moves past the current block
+        std::vector<size_t> skipped;
+        size_t stored=0;
+
+    public:
+        NameArena() = default;
+
+        // A moved-from arena is empty, so it can be reused
+        NameArena(NameArena&& other) noexcept { *this = std::move(other); }
+
+        NameArena& operator=(NameArena&& other) noexcept {
+            blocks = std::move(other.blocks);
+            sizes = std::move(other.sizes);
+            filled = std::move(other.filled);
+            skipped = std::move(other.skipped);
+            current = std::exchange(other.current, 0);
+            stored = std::exchange(other.stored, 0);
+            other.blocks.clear();
+            other.sizes.clear();
+            other.filled.clear();
+            other.skipped.clear();
+            return *this;
+        }
+
+        /** Copies 'text' into the arena and returns its reference
+         * A string that does not fit the current block goes to a block passed over earlier if one has room,
+         * otherwise to the next block with room; a string longer than a block gets a block of its own
+         **/
+        Ref store(std::string_view text) {
+            if (text.empty()) return Ref();
+            auto fits = [&](size_t block) { return filled[block] + text.size() <= sizes[block]; };
+            size_t block = current;
+            if (block < blocks.size() && !fits(block)) {
+                auto room = std::find_if(skipped.begin(), skipped.end(), fits);
+                if (room != skipped.end()) {
+                    block = *room;
+                } else {
+                    while (current < blocks.size() && !fits(current)) {
+                        if (filled[current] < sizes[current]) skipped.push_back(current);
+                        current++;
+                    }
+                    block = current;
+                }
+            }
+            if (block == blocks.size()) {
+                size_t size = std::max(blockSize, text.size());
+                blocks.emplace_back(new char[size]);
+                sizes.push_back(size);
+                filled.push_back(0);
+            }
+            std::memcpy(blocks[block].get() + filled[block], text.data(), text.size());
+            Ref ref{ static_cast<uint32_t>(block), static_cast<uint32_t>(filled[block]), static_cast<uint32_t>(text.size()) };
+            filled[block] += text.size();
+            stored += text.size();
+            return ref;
+        }
+
+        // Gives back the space of the string stored last in its block, e.g. the name of a user rejected after all
+        void discard(Ref ref) {
+            if (ref.length == 0 || ref.offset + ref.length != filled[ref.block]) return;
+            filled[ref.block] = ref.offset;
+            stored -= ref.length;
+        }
+
+        std::string_view view(Ref ref) const {
+            return ref.length ? std::string_view(blocks[ref.block].get() + ref.offset, ref.length) : std::string_view();
+        }
+
+        // Bytes of all strings stored since the last reset
+        size_t bytes() const { return stored; }
+
+        // Forgets every stored string; their references and views must not be used afterwards
+        void reset() {
+            std::fill(filled.begin(), filled.end(), 0);
+            skipped.clear();
+            current = 0;
+            stored = 0;
+        }
+};
 
 
 class UserInfoManager
 {
     private:
 
-        /** Privately held struct to store user information
-         * Only the UserInfoManager can directly access user data or create/destroy UserInfo objects
-        **/ 
-        struct UserInfo {
-            int age=0;
-            double weight=0.00;
-            double waist=0.00;
-            double neck=0.00;
-            double height=0.00;
-            double hip=0.00;
-            std::pair<int, std::string> bfp={0, "none"};
-            double calories=0;
-            double carbs=0;
-            double protein=0;
-            double fat=0;
-            std::string name;
-            std::string gender;
-            std::string lifestyle;
+        /** Privately held struct to store user information
+         * Only the UserInfoManager can directly access user data or create/destroy UserInfo objects
+        **/ 
+        struct UserInfo {
+            int age=0;
+            double weight=0.00;
+            double waist=0.00;
+            double neck=0.00;
+            double height=0.00;
+            double hip=0.00;
+            std::pair<int, std::string> bfp={0, "none"};
+            // Unrounded 'bfp', so reclassify can re-bucket it without recomputing
+            // Only the whole number is known when 'bfp' was read from a file or set directly, which 'roundedBfp' marks
+            double exactBfp=0.00;
+            bool roundedBfp=false;
+            // Per-method results filled by CombinedMethod, kept apart from the primary 'bfp' column
+            std::pair<int, std::string> usNavyBfp={0, "none"};
+            std::pair<int, std::string> bmiBfp={0, "none"};
+            double calories=0;
+            double carbs=0;
+            double protein=0;
+            double fat=0;
+            // Fingerprint of the inputs the stored results were calculated from (see fingerprintOf), or 0 if unknown
+            uint64_t fingerprint=0;
+            // Stored in 'names'; read it through nameOf
+            NameArena::Ref name;
+            std::string gender;
+            std::string lifestyle;
+            // Positions of 'gender' and 'lifestyle' in the label tables, kept in sync by encodeCategories
+            uint8_t genderCode=2;
+            uint8_t lifestyleCode=3;
+            // Set when the user is deleted; the slot is reclaimed by compaction and skipped by every scan
+            bool deleted=false;
+        };
+        
+        /** A vector of UserInfo objects to store user information
+         * Each UserInfo object represents a user and their input information
+         * 'mylist' is a private member since only the UserInfoManager can understand the UserInfo type
+         * 'mylist' is specific to the UserInfoManager instance
+        */
+        std::vector<UserInfo> mylist;
+
+        /** Index from username to the position of the first live user with that name in 'mylist'
+         * 'duplicateNames' lists, in 'mylist' order, the positions of the other live users of a name several users share,
+         * so deleting the indexed user promotes the next one without rescanning 'mylist'
+         **/
+        std::unordered_map<std::string_view, size_t> nameIndex;
+        std::unordered_map<std::string, std::deque<size_t>> duplicateNames;
+
+        /** Storage of every user's name; index keys are views into it
+         * 'deadNameBytes' counts the bytes of deleted users' names, which are reclaimed once a compaction completes (see reclaimNames)
+         **/
+        NameArena names;
+        size_t deadNameBytes=0;
+
+        /** Tombstone bookkeeping for O(1) deletes
+         * 'deadCount' counts deleted slots still in 'mylist'; compaction starts once they exceed 'compactThreshold' of all slots
+         * While compacting, [0, compactWrite) is compacted, [compactWrite, compactRead) is dead, and [compactRead, end) is untouched
+         **/
+        size_t deadCount=0;
+        double compactThreshold=0.25;
+        bool compacting=false;
+        size_t compactRead=0;
+        size_t compactWrite=0;
+
+        /** The open write-ahead journal, if any (see openJournal)
+         * 'snapshotFile' is the snapshot the journal applies on top of, and 'compactEvery' the record count that triggers compaction
+         **/
+        std::unique_ptr<MutationJournal> journal;
+        std::string snapshotFile;
+        size_t compactEvery=0;
+        
+        /** A template representing inputs for the validateInput function
+         * 'Typ' is the type of the attribute to update (string, int, or double)
+         * 'Constraint' is the type of the constraints (vector of string, pair of int, or pair of double)
+         **/ 
+        template <typename Typ, typename Constraint>
+
+        /** Validates a string, integer, or double input based on the given constraints, and updates the given attribute
+         * Private member since the UserInfoManager is responsible for collecting user inputs and updating user data
+         * Throws a runtime error if the input is invalid or outside the given limits
+         **/ 
+        void validateInput(const std::string& prompt, const std::string& error, Constraint constraints, Typ& attribute) {
+            Typ input;
+            std::cout << prompt;
+            std::cin >> input;
+
+            // Check if the attribute to update is of type int or double
+            if constexpr (std::is_same<Typ, int>::value || std::is_same<Typ, double>::value) {
+                // Check if input is invalid or outside the given limits
+                if (!std::cin || input < constraints.first || input > constraints.second) {
+                    // Clear the input buffer and throw an error
+                    std::cin.clear();
+                    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+                    throw std::runtime_error(error);
+                }
+                // Set the attribute to the input value
+                attribute = input;
+
+            // Check if the attribute to update is of type string
+            } else if constexpr (std::is_same<Typ, std::string>::value) {
+                // Convert to lowercase
+                std::transform(input.begin(), input.end(), input.begin(), ::tolower);
+                // Check if input is not the list of valid strings
+                if (std::find(constraints.begin(), constraints.end(), input) == constraints.end()) {
+                    // Throw an error
+                    throw std::runtime_error(error);
+                }
+                // Set the attribute to the input value
+                attribute = input;
+
+            // Throw an error if either the attribute type is unsupported
+            } else {
+                throw std::runtime_error("Input type" + std::string(typeid(Typ).name()) + " is not supported.");
+            }
+        }
+
+        /** Appends a number to 'out' using std::to_chars (no locale, no stream state)
+         * Doubles use the general format with 'precision' significant digits, like an ostream with setprecision
+         * A 'precision' of 0 writes the shortest representation that reads back to the same double
+         **/
+        static void appendNumber(std::string& out, int value) {
+            char digits[16];
+            out.append(digits, std::to_chars(digits, digits + sizeof(digits), value).ptr);
+        }
+        static void appendNumber(std::string& out, double value, int precision) {
+            char digits[64];
+            if (precision <= 0) {
+                out.append(digits, std::to_chars(digits, digits + sizeof(digits), value).ptr);
+            } else {
+                out.append(digits, std::to_chars(digits, digits + sizeof(digits), value, std::chars_format::general, precision).ptr);
+            }
+        }
+
+        /** Appends one user as a .csv row in the column order of writeToFile (without a trailing newline)
+         **/
+        void appendCsvRow(std::string& out, const UserInfo& user, int precision) const {
+            out += nameOf(user); out += ',';
+            out += user.gender; out += ',';
+            appendNumber(out, user.age); out += ',';
+            appendNumber(out, user.weight, precision); out += ',';
+            appendNumber(out, user.waist, precision); out += ',';
+            appendNumber(out, user.neck, precision); out += ',';
+            appendNumber(out, user.height, precision); out += ',';
+            appendNumber(out, user.hip, precision); out += ',';
+            appendNumber(out, user.bfp.first); out += ',';
+            out += user.bfp.second; out += ',';
+            appendNumber(out, user.calories, precision); out += ',';
+            appendNumber(out, user.carbs, precision); out += ',';
+            appendNumber(out, user.protein, precision); out += ',';
+            appendNumber(out, user.fat, precision); out += ',';
+            out += user.lifestyle; out += ',';
+            // An unknown fingerprint is left empty
+            if (user.fingerprint != 0) {
+                char digits[16];
+                out.append(digits, std::to_chars(digits, digits + sizeof(digits), user.fingerprint, 16).ptr);
+            }
+        }
+
+        std::string csvRow(const UserInfo& user, int precision=6) const {
+            std::string row;
+            appendCsvRow(row, user, precision);
+            return row;
+        }
+
+        /** Column names of the .csv files, in the order written by writeToFile
+         * A column projection is a bit mask over these positions
+         **/
+        inline static const std::vector<std::string> csvColumns = {
+            "name", "gender", "age", "weight", "waist", "neck", "height", "hip", "bfp", "group", "calories", "carbs", "protein", "fat", "lifestyle",
+            "fingerprint"
+        };
+        static constexpr uint32_t allColumns = (1u << 16) - 1;
+        static constexpr int fingerprintColumn = 15;
+
+        /** Converts the column names to a projection mask
+         * An empty list selects all columns
+         * Throws an invalid argument error if a column is not one of 'csvColumns'
+         **/
+        static uint32_t projectionMask(const std::vector<std::string>& columns) {
+            if (columns.empty()) return allColumns;
+            uint32_t mask = 0;
+            for (const std::string& column : columns) {
+                auto found = std::find(csvColumns.begin(), csvColumns.end(), column);
+                if (found == csvColumns.end()) {
+                    throw std::invalid_argument("Invalid column " + column + ". Must be one of the .csv header columns.");
+                }
+                mask |= 1u << (found - csvColumns.begin());
+            }
+            return mask;
+        }
+
+        /** Converts a .csv field to a number with std::from_chars
+         * An empty field (e.g. the hip of a male user in first generation files) converts to 0
+         * Throws a runtime error if the field does not start with a number
+         **/
+        template <typename T>
+        static T parseNumber(std::string_view field) {
+            while (!field.empty() && field.front() == ' ') field.remove_prefix(1);
+            T value{};
+            if (field.empty()) return value;
+            auto result = std::from_chars(field.data(), field.data() + field.size(), value);
+            if (result.ec != std::errc()) {
+                throw std::runtime_error("Invalid number '" + std::string(field) + "' in .csv row.");
+            }
+            return value;
+        }
+
+        /** Calls fn(line) for every line of an open file, reading it in large blocks
+         * Lines are passed as views into the block buffer, without their trailing newline, so no per-line copy is made
+         **/
+        template <typename Fn>
+        static void forEachLine(std::istream& file, Fn fn) {
+            const size_t blockSize = 1 << 20;
+            std::vector<char> buffer(blockSize);
+            size_t carried = 0;
+            while (true) {
+                file.read(buffer.data() + carried, buffer.size() - carried);
+                size_t filled = carried + file.gcount();
+                if (filled == 0) return;
+                bool atEnd = filled < buffer.size();
+
+                // Hand over every complete line in the block
+                TraceSpan span("parse block", "parse");
+                const char* begin = buffer.data();
+                const char* end = buffer.data() + filled;
+                while (const char* newline = static_cast<const char*>(std::memchr(begin, '\n', end - begin))) {
+                    fn(std::string_view(begin, newline - begin));
+                    begin = newline + 1;
+                }
+                if (atEnd) {
+                    if (begin < end) fn(std::string_view(begin, end - begin));
+                    return;
+                }
+
+                // Carry the partial last line over to the next block, growing the buffer for very long lines
+                carried = end - begin;
+                std::memmove(buffer.data(), begin, carried);
+                if (carried == buffer.size()) buffer.resize(buffer.size() * 2);
+            }
+        }
+
+        /** A compiled mapping from the columns of one file layout to UserInfo fields (positions in csvColumns)
+         * 'targets[c]' is the field stored from file column c, or -1 if the column is skipped
+         * 'sources[f]' is the file column holding field f, or -1 if the file has no such column
+         * 'span' is the number of leading file columns a row must be split into
+         **/
+        struct ParsePlan {
+            std::vector<int> targets;
+            std::array<int, 16> sources;
+            size_t span=0;
+        };
+
+        /** Header names accepted for each field besides its csvColumns name
+         **/
+        inline static const std::vector<std::pair<std::string, std::string>> columnAliases = {
+            {"username", "name"}, {"sex", "gender"}, {"bodyfat", "bfp"}, {"body fat", "bfp"}, {"bfp group", "group"},
+            {"bfpgroup", "group"}, {"calorie", "calories"}, {"carbohydrates", "carbs"}, {"hips", "hip"}, {"activity", "lifestyle"}
+        };
+
+        /** Column layout of the first generation files (health_assistant/main.cpp), which have no header line or name column
+         **/
+        inline static const std::vector<std::string> headerlessColumns = { "gender", "age", "weight", "waist", "neck", "hip", "height", "lifestyle" };
+
+        /** Returns the field (position in csvColumns) named by a header column, or -1 if the column is not known
+         * Names are compared in lowercase with surrounding spaces and quotes removed
+         **/
+        static int fieldOfColumn(std::string_view column) {
+            while (!column.empty() && (column.front() == ' ' || column.front() == '"')) column.remove_prefix(1);
+            while (!column.empty() && (column.back() == ' ' || column.back() == '"' || column.back() == '\r')) column.remove_suffix(1);
+            std::string name(column);
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+            for (const auto& alias : columnAliases) {
+                if (alias.first == name) { name = alias.second; break; }
+            }
+            auto found = std::find(csvColumns.begin(), csvColumns.end(), name);
+            return (found == csvColumns.end()) ? -1 : static_cast<int>(found - csvColumns.begin());
+        }
+
+        /** Compiles the plan for a file layout given its column names
+         * Only fields in 'needed' are mapped; unknown and unneeded columns are skipped
+         **/
+        static ParsePlan compilePlan(const std::vector<std::string>& header, uint32_t needed) {
+            ParsePlan plan;
+            plan.sources.fill(-1);
+            plan.targets.assign(header.size(), -1);
+            for (size_t column = 0; column < header.size(); ++column) {
+                int field = fieldOfColumn(header[column]);
+                if (field < 0 || !((needed >> field) & 1) || plan.sources[field] >= 0) continue;
+                plan.targets[column] = field;
+                plan.sources[field] = column;
+                plan.span = column + 1;
+            }
+            return plan;
+        }
+
+        /** Splits a .csv row into views of its first 'columns' fields, without copying
+         * Fields missing from a short row are left empty
+         **/
+        static void splitRow(std::string_view line, std::vector<std::string_view>& fields, size_t columns) {
+            fields.resize(columns);
+            size_t start = 0;
+            for (size_t column = 0; column < columns; ++column) {
+                if (start > line.size()) { fields[column] = std::string_view(); continue; }
+                size_t comma = line.find(',', start);
+                size_t end = (comma == std::string_view::npos) ? line.size() : comma;
+                fields[column] = line.substr(start, end - start);
+                start = end + 1;
+            }
+        }
+
+        /** Builds a UserInfo from the fields of a split row by following the plan's column targets
+         **/
+        UserInfo buildUser(const std::vector<std::string_view>& fields, const ParsePlan& plan) {
+            UserInfo newUser;
+            std::string_view name;
+            for (size_t column = 0; column < plan.span; ++column) {
+                std::string_view field = fields[column];
+                switch (plan.targets[column]) {
+                    case 0: name = field; break;
+                    case 1: newUser.gender = field; break;
+                    case 2: newUser.age = parseNumber<int>(field); break;
+                    case 3: newUser.weight = parseNumber<double>(field); break;
+                    case 4: newUser.waist = parseNumber<double>(field); break;
+                    case 5: newUser.neck = parseNumber<double>(field); break;
+                    case 6: newUser.height = parseNumber<double>(field); break;
+                    case 7: newUser.hip = parseNumber<double>(field); break;
+                    case 8: newUser.bfp.first = parseNumber<double>(field); newUser.exactBfp = newUser.bfp.first; newUser.roundedBfp = true; break;
+                    case 9: newUser.bfp.second = field; break;
+                    case 10: newUser.calories = parseNumber<double>(field); break;
+                    case 11: newUser.carbs = parseNumber<double>(field); break;
+                    case 12: newUser.protein = parseNumber<double>(field); break;
+                    case 13: newUser.fat = parseNumber<double>(field); break;
+                    case 14: newUser.lifestyle = field; break;
+                    case 15: std::from_chars(field.data(), field.data() + field.size(), newUser.fingerprint, 16); break;
+                    default: break;
+                }
+            }
+            // Stored last so a row that fails to parse leaves nothing behind in the arena
+            newUser.name = names.store(name);
+            encodeCategories(newUser);
+            return newUser;
+        }
+
+        /** Parses one .csv row in the column order of writeToFile into a UserInfo
+         **/
+        UserInfo parseRow(std::string_view line) {
+            static const ParsePlan plan = compilePlan(csvColumns, allColumns);
+            std::vector<std::string_view> fields;
+            splitRow(line, fields, plan.span);
+            return buildUser(fields, plan);
+        }
+
+        /** Appends a mutation record to the journal if one is open, compacting once 'compactEvery' records have built up
+         * Record formats: "add,<csv row>", "delete,<name>[,<n>]", and "set,<name>,<field>,<value>[,<value>]"
+         * 'n' picks the n-th later live user sharing the name (see deleteRecord); without it the first one is deleted
+         **/
+        void journalRecord(const std::string& record) {
+            if (!journal) return;
+            journal->append(record);
+            if (compactEvery > 0 && journal->recordCount() >= compactEvery) compactJournal();
+        }
+
+        // Formats a double for a journal record without losing precision
+        static std::string exact(double value) {
+            std::string out;
+            appendNumber(out, value, 17);
+            return out;
+        }
+
+        /** Applies one journal record to 'mylist' without journaling it again
+         * Throws a runtime error if the record is malformed or names a user that does not exist
+         **/
+        void applyRecord(const std::string& record) {
+            size_t comma = record.find(',');
+            std::string type = record.substr(0, comma);
+            std::string rest = (comma == std::string::npos) ? "" : record.substr(comma + 1);
+
+            if (type == "add") {
+                appendUser(parseRow(rest));
+            } else if (type == "delete") {
+                size_t comma = rest.find(',');
+                eraseUser(rest.substr(0, comma), (comma == std::string::npos) ? 0 : std::stoull(rest.substr(comma + 1)));
+            } else if (type == "set") {
+                std::istringstream iss(rest);
+                std::string username, field, value;
+                std::getline(iss, username, ',');
+                std::getline(iss, field, ',');
+                std::getline(iss, value, ',');
+                rescore(username, [&](UserInfo& user) {
+                    if (field == "lifestyle") { user.lifestyle = value; encodeCategories(user); }
+                    else if (field == "bfp") { user.bfp.first = user.exactBfp = std::stoi(value); user.roundedBfp = true; std::getline(iss, user.bfp.second, ','); }
+                    else if (field == "calories") user.calories = std::stod(value);
+                    else if (field == "carbs") user.carbs = std::stod(value);
+                    else if (field == "protein") user.protein = std::stod(value);
+                    else if (field == "fat") user.fat = std::stod(value);
+                    else throw std::runtime_error("Invalid journal record: " + record);
+                    // A result set directly is no longer the calculated one
+                    if (field != "lifestyle") user.fingerprint = 0;
+                });
+            } else {
+                throw std::runtime_error("Invalid journal record: " + record);
+            }
+        }
+
+        /** Appends a user to 'mylist' and indexes its name
+         **/
+        void appendUser(UserInfo&& user) {
+            mylist.push_back(std::move(user));
+            indexName(mylist.size() - 1);
+            admit(mylist.size() - 1);
+        }
+
+        /** Indexes the name of the user at 'position', which must come after every other live user with that name
+         **/
+        void indexName(size_t position) {
+            // Users loaded without the name column cannot be looked up, so they are not indexed
+            if (mylist[position].name.length == 0) return;
+            std::string_view name = nameOf(mylist[position]);
+            if (!nameIndex.emplace(name, position).second) duplicateNames[std::string(name)].push_back(position);
+        }
+
+        /** Removes the user at 'position' from the name index, promoting the next live user with that name if there is one
+         **/
+        void unindexName(size_t position) {
+            std::string_view name = nameOf(mylist[position]);
+            auto entry = nameIndex.find(name);
+            if (entry == nameIndex.end()) return;
+            auto others = duplicateNames.empty() ? duplicateNames.end() : duplicateNames.find(std::string(name));
+            if (others == duplicateNames.end()) {
+                if (entry->second == position) nameIndex.erase(entry);
+                return;
+            }
+            std::deque<size_t>& positions = others->second;
+            if (entry->second == position) {
+                // Re-key the entry so it views the name of the user it now points at
+                size_t next = positions.front();
+                nameIndex.erase(entry);
+                nameIndex.emplace(nameOf(mylist[next]), next);
+                positions.pop_front();
+            } else {
+                auto listed = std::lower_bound(positions.begin(), positions.end(), position);
+                if (listed != positions.end() && *listed == position) positions.erase(listed);
+            }
+            if (positions.empty()) duplicateNames.erase(others);
+        }
+
+        /** Points the name index at 'to' for the user being moved from 'from' (before it is moved)
+         **/
+        void moveName(size_t from, size_t to) {
+            std::string_view name = nameOf(mylist[from]);
+            auto entry = nameIndex.find(name);
+            if (entry == nameIndex.end()) return;
+            if (entry->second == from) {
+                entry->second = to;
+                return;
+            }
+            if (duplicateNames.empty()) return;
+            auto others = duplicateNames.find(std::string(name));
+            if (others == duplicateNames.end()) return;
+            // Users move down in 'mylist' order, so the positions stay sorted
+            auto listed = std::lower_bound(others->second.begin(), others->second.end(), from);
+            if (listed != others->second.end() && *listed == from) *listed = to;
+        }
+
+        /** Journal record deleting the user at 'position'
+         * A user that is not the first live one with its name also gets its rank among the others, so replay deletes the same user
+         **/
+        std::string deleteRecord(size_t position) {
+            std::string_view name = nameOf(mylist[position]);
+            std::string record = std::string("delete,").append(name);
+            auto entry = nameIndex.find(name);
+            if (entry == nameIndex.end() || entry->second == position || duplicateNames.empty()) return record;
+            auto others = duplicateNames.find(std::string(name));
+            if (others == duplicateNames.end()) return record;
+            size_t rank = std::lower_bound(others->second.begin(), others->second.end(), position) - others->second.begin();
+            return record.append(",").append(std::to_string(rank + 1));
+        }
+
+        /** Adds the user at 'position' to the live aggregates and to every view it matches
+         **/
+        void admit(size_t position) {
+            const UserInfo& user = mylist[position];
+            live.apply(user, 1);
+            for (auto& view : views) {
+                if (inView(view.second, user)) view.second.members.insert(position);
+            }
+        }
+
+        /** Removes the user at 'position' from the live aggregates and from every view
+         **/
+        void retract(size_t position) {
+            live.apply(mylist[position], -1);
+            for (auto& view : views) view.second.members.erase(position);
+        }
+
+        /** Moves the view memberships of a user that compaction moved from 'from' to 'to'
+         **/
+        void relocate(size_t from, size_t to) {
+            for (auto& view : views) {
+                if (view.second.members.erase(from) > 0) view.second.members.insert(to);
+            }
+        }
+
+        /** Removes every user, tombstone and index entry
+         * Every bulk load goes through here, so it throws a runtime error while a journal is open: the change would not be journaled
+         **/
+        void resetUsers() {
+            if (journal) {
+                throw std::runtime_error("Users cannot be loaded or cleared while a journal is open; close the journal first.");
+            }
+            mylist.clear();
+            nameIndex.clear();
+            duplicateNames.clear();
+            names.reset();
+            deadNameBytes = 0;
+            live = LiveStats();
+            for (auto& view : views) view.second.members.clear();
+            deadCount = 0;
+            compacting = false;
+        }
+
+        /** Marks the user at 'position' as deleted and points the name index at the next live user with that name, if any
+         **/
+        void tombstone(size_t position) {
+            retract(position);
+            unindexName(position);
+            mylist[position].deleted = true;
+            deadCount++;
+            deadNameBytes += mylist[position].name.length;
+        }
+
+        /** Deletes the first user found with the given username in O(1) by marking a tombstone
+         * If 'occurrence' is set, deletes that many users further along among the live users sharing the name instead
+         * Throws a runtime error if the user is not found
+         **/
+        void eraseUser(const std::string& username, size_t occurrence=0) {
+            auto entry = nameIndex.find(username);
+            // Throw an error if user not found
+            if (entry == nameIndex.end()) {
+                throw std::runtime_error("User with name " + username + " does not exist.");
+            }
+            size_t position = entry->second;
+            if (occurrence > 0) {
+                auto others = duplicateNames.find(username);
+                if (others == duplicateNames.end() || occurrence > others->second.size()) {
+                    throw std::runtime_error("User with name " + username + " does not exist.");
+                }
+                position = others->second[occurrence - 1];
+            }
+            tombstone(position);
+            compactStep();
+        }
+
+        /** Advances compaction by moving at most 'budget' slots, starting a compaction if the dead fraction reached the threshold
+         * Live users are moved down over dead slots and re-indexed; the tail is dropped once the whole list has been visited
+         **/
+        void compactStep(size_t budget=4096) {
+            if (!compacting) {
+                if (mylist.empty() || deadCount < compactThreshold * mylist.size()) return;
+                compacting = true;
+                compactRead = 0;
+                compactWrite = 0;
+            }
+            TraceSpan span("compact step", "index");
+            for (; budget > 0 && compactRead < mylist.size(); --budget, ++compactRead) {
+                UserInfo& user = mylist[compactRead];
+                if (user.deleted) continue;
+                if (compactRead != compactWrite) {
+                    moveName(compactRead, compactWrite);
+                    relocate(compactRead, compactWrite);
+                    mylist[compactWrite] = std::move(user);
+                    user.deleted = true;
+                }
+                compactWrite++;
+            }
+            if (compactRead == mylist.size()) {
+                // Every slot from compactWrite onwards is dead
+                deadCount -= mylist.size() - compactWrite;
+                mylist.resize(compactWrite);
+                compacting = false;
+                reclaimNames();
+            }
+        }
+
+        /** Copies the names of the live users into a fresh arena once deleted users' names make up half of the arena
+         * Runs when a compaction completes; the copy is paid for by the deletes that made the garbage,
+         * so a long-running process with constant churn keeps its name storage proportional to its live users
+         **/
+        void reclaimNames() {
+            if (deadNameBytes < (1 << 16) || deadNameBytes * 2 < names.bytes()) return;
+            TraceSpan span("reclaim names", "index");
+            NameArena fresh;
+            for (size_t i = 0; i < mylist.size(); ++i) {
+                UserInfo& user = mylist[i];
+                // Users deleted behind the compaction are still in 'mylist' but their names are no longer needed
+                if (user.deleted) user.name = NameArena::Ref();
+                if (user.name.length == 0) continue;
+                std::string_view old = nameOf(user);
+                user.name = fresh.store(old);
+                // Re-key the index entry of this user so it views the new copy
+                auto entry = nameIndex.find(old);
+                if (entry != nameIndex.end() && entry->second == i) {
+                    auto node = nameIndex.extract(entry);
+                    node.key() = fresh.view(user.name);
+                    nameIndex.insert(std::move(node));
+                }
+            }
+            names = std::move(fresh);
+            deadNameBytes = 0;
+        }
+
+        /** Label tables for the categorical columns used as group-by keys
+         * The position of a label in its table is the code stored in a packed group key
+         **/
+        inline static const std::vector<std::string> ageBands = { "under 20", "20-39", "40-59", "60-79", "80+" };
+        inline static const std::vector<std::string> genders = { "female", "male", "unknown" };
+        inline static const std::vector<std::string> lifestyles = { "sedentary", "moderate", "active", "unknown" };
+        inline static const std::vector<std::string> bfpGroupNames = {
+            "none", "low", "normal", "high", "very high", "underweight", "healthy weight", "overweight", "obesity", "unknown"
+        };
+        inline static const std::vector<std::string> methods = { "none", "USNavy", "bmi" };
+
+        /** Returns the position of 'value' in 'labels', or the last position ("unknown") if it is not listed
+         **/
+        static uint32_t labelCode(const std::vector<std::string>& labels, const std::string& value) {
+            for (size_t i = 0; i + 1 < labels.size(); ++i) {
+                if (labels[i] == value) return i;
+            }
+            return labels.size() - 1;
+        }
+
+        /** Updates the cached category codes of a user after its gender or lifestyle changed
+         **/
+        static void encodeCategories(UserInfo& user) {
+            user.genderCode = labelCode(genders, user.gender);
+            user.lifestyleCode = labelCode(lifestyles, user.lifestyle);
+        }
+
+        /** Maps an age to the brackets used by USNavyMethod::getBfpGroup (20-39, 40-59, 60-79)
+         **/
+        static uint32_t ageBandCode(int age) {
+            if (age < 20) return 0;
+            if (age <= 39) return 1;
+            if (age <= 59) return 2;
+            if (age <= 79) return 3;
+            return 4;
+        }
+
+        /** Maps a bfp group code to the method that produces it (USNavy groups come before the bmi groups)
+         **/
+        static uint32_t methodCode(uint32_t groupCode) {
+            if (groupCode >= 1 && groupCode <= 4) return 1;
+            if (groupCode >= 5 && groupCode <= 8) return 2;
+            return 0;
+        }
+
+        inline static const std::vector<std::string> numericFields = {
+            "age", "weight", "waist", "neck", "height", "hip", "bfp", "calories", "carbs", "protein", "fat"
+        };
+
+        /** Column types and schema of the columnar export (see writeColumnar)
+         **/
+        enum class ColumnType : uint8_t { Int32 = 1, Float64 = 2, Category = 3, String = 4, UInt64 = 5 };
+        struct ColumnSpec {
+            std::string name;
+            ColumnType type;
+            const std::vector<std::string>* labels;
+        };
+        inline static const std::vector<ColumnSpec> columnarSchema = {
+            {"name", ColumnType::String, nullptr}, {"gender", ColumnType::Category, &genders},
+            {"age", ColumnType::Int32, nullptr}, {"weight", ColumnType::Float64, nullptr},
+            {"waist", ColumnType::Float64, nullptr}, {"neck", ColumnType::Float64, nullptr},
+            {"height", ColumnType::Float64, nullptr}, {"hip", ColumnType::Float64, nullptr},
+            {"bfp", ColumnType::Int32, nullptr}, {"group", ColumnType::Category, &bfpGroupNames},
+            {"calories", ColumnType::Float64, nullptr}, {"carbs", ColumnType::Float64, nullptr},
+            {"protein", ColumnType::Float64, nullptr}, {"fat", ColumnType::Float64, nullptr},
+            {"lifestyle", ColumnType::Category, &lifestyles}, {"fingerprint", ColumnType::UInt64, nullptr},
+            {"exactbfp", ColumnType::Float64, nullptr}, {"usnavybfp", ColumnType::Int32, nullptr},
+            {"usnavygroup", ColumnType::Category, &bfpGroupNames}, {"bmibfp", ColumnType::Int32, nullptr},
+            {"bmigroup", ColumnType::Category, &bfpGroupNames}
+        };
+        // Calculated fields only the columnar export keeps, numbered after 'csvColumns' when a file is read
+        inline static const std::vector<std::string> columnarFields = { "exactbfp", "usnavybfp", "usnavygroup", "bmibfp", "bmigroup" };
+
+        // Appends the raw bytes of a fixed-width value to 'out'
+        template <typename T>
+        static void appendRaw(std::string& out, T value) {
+            out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+
+        /** Returns a function reading the given numeric field of a UserInfo
+         * Throws an invalid argument error if the field is not one of 'numericFields'
+         **/
+        static double (*fieldReader(const std::string& field))(const UserInfo&) {
+            if (field == "age") return [](const UserInfo& user) { return static_cast<double>(user.age); };
+            if (field == "weight") return [](const UserInfo& user) { return user.weight; };
+            if (field == "waist") return [](const UserInfo& user) { return user.waist; };
+            if (field == "neck") return [](const UserInfo& user) { return user.neck; };
+            if (field == "height") return [](const UserInfo& user) { return user.height; };
+            if (field == "hip") return [](const UserInfo& user) { return user.hip; };
+            if (field == "bfp") return [](const UserInfo& user) { return static_cast<double>(user.bfp.first); };
+            if (field == "calories") return [](const UserInfo& user) { return user.calories; };
+            if (field == "carbs") return [](const UserInfo& user) { return user.carbs; };
+            if (field == "protein") return [](const UserInfo& user) { return user.protein; };
+            if (field == "fat") return [](const UserInfo& user) { return user.fat; };
+            throw std::invalid_argument("Invalid field " + field + ". Must be one of age, weight, waist, neck, height, hip, bfp, calories, carbs, protein, or fat.");
+        }
+
+        /** Checks whether a user belongs to the cohort given by a gender and an age band label
+         * Empty strings match every user
+         **/
+        static bool inCohort(const UserInfo& user, const std::string& gender, const std::string& ageBand) {
+            if (!gender.empty() && user.gender != gender) return false;
+            if (!ageBand.empty() && ageBands[ageBandCode(user.age)] != ageBand) return false;
+            return true;
+        }
+
+        /** Returns the number of worker threads to use for a scan over 'count' users
+         * Small populations are scanned on the calling thread since spawning threads would cost more than the scan
+         **/
+        static size_t workerCount(size_t count) {
+            size_t hardware = std::max<size_t>(1, std::thread::hardware_concurrency());
+            return std::max<size_t>(1, std::min(hardware, count / 16384));
+        }
+
+        /** Splits [0, count) into 'workers' contiguous ranges and calls work(begin, end, worker) for each range
+         * Ranges after the first run on their own threads, the first runs on the calling thread
+         **/
+        template <typename Work>
+        static void parallelRanges(size_t count, size_t workers, Work work) {
+            std::vector<std::thread> threads;
+            size_t phase = AllocationTracker::currentPhase();
+            size_t step = (count + workers - 1) / workers;
+            for (size_t worker = 1; worker < workers; ++worker) {
+                size_t begin = std::min(count, worker * step);
+                size_t end = std::min(count, begin + step);
+                threads.emplace_back([&work, begin, end, worker, phase] {
+                    AllocationPhase allocations(phase);
+                    TraceSpan span("worker range", "compute");
+                    work(begin, end, worker);
+                });
+            }
+            {
+                TraceSpan span("worker range", "compute");
+                work(size_t(0), std::min(count, step), size_t(0));
+            }
+            for (std::thread& thread : threads) {
+                thread.join();
+            }
+        }
+
+        /** Calls fn(user) for the user with the given name, retracting the user from the live aggregates before and admitting it after
+         * Throws a runtime error if the user is not found; if fn throws, the user is admitted again as it was left
+         * Views are kept up to date the same way
+         **/
+        template <typename Fn>
+        void rescore(const std::string& username, Fn fn) {
+            UserInfo& user = findUser(username);
+            size_t position = &user - mylist.data();
+            retract(position);
+            try {
+                fn(user);
+            } catch (...) {
+                admit(position);
+                throw;
+            }
+            admit(position);
+        }
+
+        /** Finds the UserInfo with the given name in the private UserInfo vector 'mylist'
+         * The UserInfo vector searched is specific to the UserInfoManager instance
+         * Private member since only a UserInfoManager understands the UserInfo type (returns UserInfo&)
+         * Throws a runtime error if the user is not found
+         **/ 
+        UserInfo& findUser(const std::string& username) {
+            LatencyTimer timer("findUser");
+            // Find user according to username
+            auto entry = nameIndex.find(username);
+            // Throw an error if user not found
+            if (entry == nameIndex.end()) {
+                throw std::runtime_error("User with name " + username + " does not exist.");
+            }
+            // Return user if found
+            return mylist[entry->second];
+        }
+
+    public:
+
+        /** Running totals of the live users in one gender and bfp group
+         * Sums are kept rather than means so users can be added and removed; they may drift by rounding after many updates
+         **/
+        struct LiveCell {
+            long long count=0;
+            double bfp=0.00;
+            double calories=0.00;
+            double carbs=0.00;
+            double protein=0.00;
+            double fat=0.00;
+
+            void add(const LiveCell& other) {
+                count += other.count;
+                bfp += other.bfp;
+                calories += other.calories;
+                carbs += other.carbs;
+                protein += other.protein;
+                fat += other.fat;
+            }
+        };
+
+        /** Aggregates of the live users by gender, bfp group and method, kept up to date by every mutation
+         * Cells are indexed by the codes of 'genders' and 'bfpGroupNames'; each group belongs to one method (see methodCode)
+         **/
+        struct LiveStats {
+            std::array<std::array<LiveCell, 10>, 3> cells;
+
+            // Totals of one gender ("" for all) over the given groups
+            LiveCell total(const std::string& gender, const std::vector<std::string>& groups) const {
+                LiveCell sum;
+                for (uint32_t g = 0; g < cells.size(); ++g) {
+                    if (!gender.empty() && genders[g] != gender) continue;
+                    for (const std::string& group : groups) sum.add(cells[g][labelCode(bfpGroupNames, group)]);
+                }
+                return sum;
+            }
+
+            // Totals of one gender ("" for all) over every group except "unknown", like allUsers
+            LiveCell total(const std::string& gender) const {
+                return total(gender, std::vector<std::string>(bfpGroupNames.begin(), bfpGroupNames.end() - 1));
+            }
+
+            // Totals of one gender ("" for all) over every group of a method ("USNavy", "bmi" or "none")
+            LiveCell methodTotal(const std::string& gender, const std::string& method) const {
+                std::vector<std::string> groups;
+                for (uint32_t group = 0; group + 1 < bfpGroupNames.size(); ++group) {
+                    if (methods[methodCode(group)] == method) groups.push_back(bfpGroupNames[group]);
+                }
+                return total(gender, groups);
+            }
+
+            // Adds (sign 1) or removes (sign -1) one user's contribution
+            void apply(const UserInfo& user, int sign) {
+                LiveCell& cell = cells[user.genderCode][labelCode(bfpGroupNames, user.bfp.second)];
+                cell.count += sign;
+                cell.bfp += sign * user.bfp.first;
+                cell.calories += sign * user.calories;
+                cell.carbs += sign * user.carbs;
+                cell.protein += sign * user.protein;
+                cell.fat += sign * user.fat;
+            }
+
+            void merge(const LiveStats& other) {
+                for (size_t g = 0; g < cells.size(); ++g) {
+                    for (size_t group = 0; group < cells[g].size(); ++group) cells[g][group].add(other.cells[g][group]);
+                }
+            }
+        };
+
+    private:
+        // Aggregates of the live users; every mutation retracts a user's old contribution and admits the new one
+        LiveStats live;
+
+        /** A named cohort kept as the set of positions in 'mylist' of the live users matching its filter
+         * Maintained by the same hooks as 'live', and moved along with its users by compaction
+         **/
+        struct View {
+            ScanFilter filter;
+            std::unordered_set<size_t> members;
+        };
+        std::unordered_map<std::string, View> views;
+
+        // A membership change found by a forEachUser worker, applied after the workers are done
+        struct ViewChange {
+            View* view;
+            size_t position;
+            bool member;
+        };
+
+        static bool inView(const View& view, const UserInfo& user) {
+            return view.filter.matches(user.gender, user.age, user.lifestyle, user.bfp.second);
+        }
+
+        View& findView(const std::string& name) {
+            auto view = views.find(name);
+            if (view == views.end()) throw std::runtime_error("View " + name + " does not exist.");
+            return view->second;
+        }
+
+    public:
+        /** Returns the aggregates of the live users in O(1), e.g. for dashboards that poll continuously
+         **/
+        const LiveStats& liveStats() const { return live; }
+
+        /** Registers a named view of the users matching 'filter', e.g. "unhealthy males 40-59", and fills it with one scan
+         * From then on the view is updated on every add, delete and change, and survives clearing the users
+         * Throws an invalid argument error if a view with that name already exists
+         **/
+        void createView(const std::string& name, const ScanFilter& filter) {
+            LatencyTimer timer("createView");
+            if (views.count(name)) throw std::invalid_argument("View " + name + " already exists.");
+            View& view = views[name];
+            view.filter = filter;
+            for (size_t i = 0; i < mylist.size(); ++i) {
+                if (!mylist[i].deleted && inView(view, mylist[i])) view.members.insert(i);
+            }
+        }
+
+        /** Removes a named view
+         * Throws a runtime error if the view does not exist
+         **/
+        void dropView(const std::string& name) {
+            findView(name);
+            views.erase(name);
+        }
+
+        /** Gets the usernames of the users in a view, in load order, without scanning the other users
+         * Throws a runtime error if the view does not exist
+         **/
+        std::vector<std::string> viewUsers(const std::string& name) {
+            LatencyTimer timer("viewUsers");
+            const View& view = findView(name);
+            std::vector<size_t> positions(view.members.begin(), view.members.end());
+            std::sort(positions.begin(), positions.end());
+            std::vector<std::string> usernames;
+            usernames.reserve(positions.size());
+            for (size_t position : positions) usernames.emplace_back(nameOf(mylist[position]));
+            return usernames;
+        }
+
+        /** Gets the names of all registered views
+         **/
+        std::vector<std::string> viewNames() const {
+            std::vector<std::string> registered;
+            for (const auto& view : views) registered.push_back(view.first);
+            std::sort(registered.begin(), registered.end());
+            return registered;
+        }
+
+        /** Label tables the live aggregates are indexed by, in index order
+         **/
+        static const std::vector<std::string>& genderLabels() { return genders; }
+        static const std::vector<std::string>& bfpGroupLabels() { return bfpGroupNames; }
+
+        /** Returns a user's name, e.g. for the predicate of deleteWhere
+         * The view stays valid until the users are cleared
+         **/
+        std::string_view nameOf(const UserInfo& user) const { return names.view(user.name); }
+
+        /** Columns a user is entered with, before anything is calculated
+         **/
+        inline static const std::vector<std::string> inputColumns = { "name", "gender", "age", "weight", "waist", "neck", "height", "hip", "lifestyle" };
+
+        /** Running summary of one numeric field within a group
+         * Uses Welford's method so that partial summaries from different threads can be merged exactly
+         **/
+        struct FieldSummary {
+            long long count=0;
+            double mean=0.00;
+            double m2=0.00;
+            double min=std::numeric_limits<double>::max();
+            double max=std::numeric_limits<double>::lowest();
+
+            void add(double value) {
+                count++;
+                double delta = value - mean;
+                mean += delta / count;
+                m2 += delta * (value - mean);
+                min = std::min(min, value);
+                max = std::max(max, value);
+            }
+
+            void merge(const FieldSummary& other) {
+                if (other.count == 0) return;
+                if (count == 0) { *this = other; return; }
+                long long total = count + other.count;
+                double delta = other.mean - mean;
+                mean += delta * other.count / total;
+                m2 += other.m2 + delta * delta * (static_cast<double>(count) * other.count / total);
+                count = total;
+                min = std::min(min, other.min);
+                max = std::max(max, other.max);
+            }
+
+            // Population variance of the summarized values
+            double variance() const { return count > 0 ? m2 / count : 0.00; }
+        };
+
+        /** One output row of groupBy
+         * Key columns that were not grouped on hold "*"
+         **/
+        struct GroupStats {
+            std::string ageBand="*";
+            std::string gender="*";
+            std::string lifestyle="*";
+            std::string group="*";
+            std::string method="*";
+            long long count=0;
+            FieldSummary bfp;
+            FieldSummary calories;
+            FieldSummary carbs;
+            FieldSummary protein;
+            FieldSummary fat;
+        };
+
+        /** Constructor
+         * Initializes the empty vector of UserInfo objects 'mylist'
+         * The vector is specific to the UserInfoManager instance
+         **/
+        UserInfoManager() : mylist() {}
+
+        /** Destructor
+         * Clears the vector of UserInfo objects 'mylist'
+         * The vector is specific to the UserInfoManager instance
+         * An open journal commits its buffered records when it is destroyed
+         **/
+        ~UserInfoManager() { mylist.clear(); }
+
+        UserInfoManager(UserInfoManager&&) = default;
+        UserInfoManager& operator=(UserInfoManager&&) = default;
+
+        // Method to clear mylist of all users
+        void clearUsers() { resetUsers(); }
+
+        /** Moves the users into a new UserInfoManager, leaving this one empty
+         * The views and journal settings stay here
+         * Throws a runtime error while a journal is open, since the move would not be journaled
+         **/
+        UserInfoManager releaseUsers() {
+            if (journal) {
+                throw std::runtime_error("Users cannot be released while a journal is open; close the journal first.");
+            }
+            UserInfoManager users(std::move(*this));
+            views = std::move(users.views);
+            users.views.clear();
+            snapshotFile = std::move(users.snapshotFile);
+            compactEvery = users.compactEvery;
+            compactThreshold = users.compactThreshold;
+            resetUsers();
+            return users;
+        }
+
+        // Approximate memory held by one loaded user, used to budget out-of-core processing
+        static constexpr size_t bytesPerUser = sizeof(UserInfo) + 64;
+
+        // Number of users, not counting deleted ones
+        size_t userCount() const { return mylist.size() - deadCount; }
+
+        /** Sets the fraction of deleted slots at which compaction starts reclaiming space
+         **/
+        void setCompactionThreshold(double fraction) { compactThreshold = std::clamp(fraction, 0.0, 1.0); }
+
+        /** Adds a new user to the 'mylist' vector
+         * Prompts the user for input and validates the input
+         * Throws a runtime error if the input is invalid or outside the given limits
+         **/
+        void addUserInfo() {
+            LatencyTimer timer("addUserInfo");
+            UserInfo newUser;
+
+            // Prompt for name input
+            std::string input;
+            std::cout << "\nPlease enter your name: ";
+
+            // Validate name input (only letters)
+            std::cin >> input;
+            for (char c : input) {
+                if (!std::isalpha(c)) {
+                    throw std::runtime_error("Invalid name. Please enter a name containing only letters.");
+                }
+            }
+
+            // Prompt for and validate gender
+            std::vector<std::string> validGenders = { "female", "male" };
+            validateInput(
+                "Please specify your gender as either male or female: ", 
+                "Invalid gender. Gender must be either male or female.", 
+                validGenders, newUser.gender
+            );
+
+            // Prompt for and validate age
+            std::pair<int, int> ageRange = { 19, 79 };
+            validateInput(
+                "Enter your age: ", 
+                "Invalid age. Age must be between 19 and 79.", 
+                ageRange, newUser.age
+            );
+
+            // create a vector of pairs to simplify the measurement input validation process
+            std::vector<std::pair<std::string, double*>> attributes = {
+                {"Enter your body weight in kilograms: ", &newUser.weight},
+                {"Enter your waist measurement in centimeters: ", &newUser.waist},
+                {"Enter your neck measurement in centimeters: ", &newUser.neck},
+                {"Enter your height measurement in centimeters: ", &newUser.height},
+                {"Enter your hip measurement in centimeters: ", &newUser.hip}
+            };
+
+            // Prompt for and validate body measurements
+            std::pair<double, double> measurementRange = { 0, std::numeric_limits<double>::max() };
+            for (auto& attribute : attributes) {
+                // Skip hip measurement if the user is a male
+                if ((attribute.second == &newUser.hip) && (newUser.gender == "male")){
+                    continue;
+                };
+                validateInput(
+                    attribute.first, 
+                    "Invalid measurement. Measurement must be greater than 0.0.", 
+                    measurementRange, *attribute.second
+                );
+            };  
+
+            // Prompt for and validate lifestyle
+            std::vector<std::string> validLifestyles = { "sedentary", "moderate", "active" };
+            validateInput(
+                "Enter information about your current lifestyle (sedentary, moderate, or active): ", 
+                "Invalid lifestyle. Lifestyle must be either sedentary, moderate, or active.", 
+                validLifestyles, newUser.lifestyle
+            );
+
+            // Print success message and add user to 'mylist'
+            std::cout << "User " << input << " has been added successfully.\n" << std::endl;
+            std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        
+            // The name is only stored once the whole entry is valid, so rejected entries leave nothing in the arena
+            newUser.name = names.store(input);
+            encodeCategories(newUser);
+            journalRecord("add," + csvRow(newUser, 17));
+            appendUser(std::move(newUser));
+        }
+
+        /** Adds a new user from a .csv row in the column order of 'inputColumns', without prompting
+         * Validates the row like addUserInfo; calculated fields are left for the caller to fill
+         * Throws a runtime error if a field is invalid or a user with the same name already exists
+         **/
+        void addUserRow(std::string_view row) {
+            LatencyTimer timer("addUserRow");
+            static const ParsePlan plan = compilePlan(inputColumns, allColumns);
+            std::vector<std::string_view> fields;
+            splitRow(row, fields, plan.span);
+            std::string_view name = fields[0];
+            if (name.empty() || !std::all_of(name.begin(), name.end(), [](char c) { return std::isalpha(static_cast<unsigned char>(c)); })) {
+                throw std::runtime_error("Invalid name. Please enter a name containing only letters.");
+            }
+            if (nameIndex.count(name)) {
+                throw std::runtime_error("User with name " + std::string(name) + " already exists.");
+            }
+            UserInfo newUser = buildUser(fields, plan);
+            const char* invalid = nullptr;
+            if (newUser.gender != "female" && newUser.gender != "male") {
+                invalid = "Invalid gender. Gender must be either male or female.";
+            } else if (newUser.age < 19 || newUser.age > 79) {
+                invalid = "Invalid age. Age must be between 19 and 79.";
+            } else if (!(newUser.weight > 0) || !(newUser.waist > 0) || !(newUser.neck > 0) || !(newUser.height > 0)
+                       || (newUser.gender == "female" && !(newUser.hip > 0))) {
+                invalid = "Invalid measurement. Measurement must be greater than 0.0.";
+            } else if (newUser.lifestyle != "sedentary" && newUser.lifestyle != "moderate" && newUser.lifestyle != "active") {
+                invalid = "Invalid lifestyle. Lifestyle must be either sedentary, moderate, or active.";
+            }
+            if (invalid) {
+                // A rejected row leaves nothing behind in the arena
+                names.discard(newUser.name);
+                throw std::runtime_error(invalid);
+            }
+
+            journalRecord("add," + csvRow(newUser, 17));
+            appendUser(std::move(newUser));
+        }
+
+        /** Deletes a user from the 'mylist' vector
+         * Removes the first user found with the given username in 'mylist'
+         * Throws a runtime error if the user is not found
+         **/
+        void deleteUser(const std::string& username) {
+            LatencyTimer timer("deleteUser");
+            eraseUser(username);
+            journalRecord("delete," + username);
+        }
+
+        /** Deletes every user for which pred(user) is true in one linear pass, and reclaims all dead slots in the same pass
+         * 'pred' must be a generic lambda since the UserInfo type is private to the UserInfoManager
+         * Returns the number of users deleted
+         **/
+        template <typename Pred>
+        size_t deleteWhere(Pred pred) {
+            LatencyTimer timer("deleteWhere");
+            size_t removed = 0;
+            size_t write = 0;
+            for (size_t read = 0; read < mylist.size(); ++read) {
+                UserInfo& user = mylist[read];
+                if (user.deleted) continue;
+                if (pred(static_cast<const UserInfo&>(user))) {
+                    retract(read);
+                    if (journal) journalRecord(deleteRecord(read));
+                    unindexName(read);
+                    deadNameBytes += user.name.length;
+                    removed++;
+                    continue;
+                }
+                if (read != write) {
+                    moveName(read, write);
+                    relocate(read, write);
+                    mylist[write] = std::move(user);
+                }
+                write++;
+            }
+            mylist.resize(write);
+            deadCount = 0;
+            compacting = false;
+            reclaimNames();
+            return removed;
+        }
+
+        /** Filters usernames based on body fat percentage
+         * Returns a vector of strings containing all usernames that fall into the given bfp groups
+         **/
+        std::vector<std::string> filterUsernames(const std::vector<std::string>& bfpGroups, const std::string& gender) {
+            std::vector<std::string> validUsernames;
+            // Iterate through all loaded users
+            for (const UserInfo &user : mylist) {
+                if (user.deleted) continue;
+                // Continue if the user's bfp group is in the list of valid groups
+                if (std::find(bfpGroups.begin(), bfpGroups.end(), user.bfp.second) != bfpGroups.end()) {
+                    if (gender == "") {
+                        // If the gender isn't specified, add the username to the list
+                        validUsernames.emplace_back(nameOf(user));
+                    } else if (user.gender == gender) {
+                        // Else add the username to the list if the user's gender matches the input
+                        validUsernames.emplace_back(nameOf(user));
+                    }
+                }
+            }
+            return validUsernames;
+        }
+
+        /** Gets the usernames of all users matching a filter, in load order
+         **/
+        std::vector<std::string> filterUsers(const ScanFilter& filter) {
+            LatencyTimer timer("filterUsers");
+            std::vector<std::string> usernames;
+            for (const UserInfo& user : mylist) {
+                if (!user.deleted && filter.matches(user.gender, user.age, user.lifestyle, user.bfp.second)) usernames.emplace_back(nameOf(user));
+            }
+            return usernames;
+        }
+
+        /** Gets all usernames in this UserInfoManager instance's 'mylist' vector
+         * Returns a vector of strings containing all usernames
+         * Public member since other classes need to iterate through all users
+         **/
+        std::vector<std::string> getBfpUsers(std::vector<std::string> bfpGroups, std::string gender="") {
+            LatencyTimer timer("getBfpUsers");
+            std::vector<std::string> bfpUsers;
+
+            if (gender!="male"&&gender!="female"&&gender!="") {
+                throw std::invalid_argument("Gender must be either 'male' or 'female', or left blank.");
+            }
+            for (const UserInfo &user : mylist) {
+                if (user.deleted) continue;
+                if (user.bfp.second == "none" && bfpGroups.size()<8) {
+                    throw std::runtime_error("Body fat percentage has not been calculated for all users.");
+                } else if (std::find(bfpGroups.begin(), bfpGroups.end(), user.bfp.second) != bfpGroups.end() && (user.gender == gender || gender == "")) {
+                    bfpUsers.emplace_back(nameOf(user));
+                }
+            }
+            return bfpUsers;
+        }
+
+        std::vector<std::string> healthyUsers(std::string gender="") {
+            return getBfpUsers({"normal", "healthy weight"}, gender);
+        }
+
+        std::vector<std::string> unhealthyUsers(std::string gender="") {
+            return getBfpUsers({"high", "very high", "overweight", "obesity", "low", "underweight"}, gender);
+        }
+
+        std::vector<std::string> allUsers(std::string gender="") {
+            return getBfpUsers({"low", "normal", "high", "very high", "none", "underweight", "overweight", "healthy weight", "obesity"}, gender);
+        }
+
+        /** Aggregates all users grouped by any combination of "age", "gender", "lifestyle", "group" and "method"
+         * Computes count, mean, min, max and variance of bfp, calories and macros for each group
+         * Runs as a single hash-aggregation pass with one partial table per thread, merged at the end
+         * Throws an invalid argument error if a key is not recognized
+         **/
+        std::vector<GroupStats> groupBy(const std::vector<std::string>& keys) {
+            LatencyTimer timer("groupBy");
+            // Each key owns one byte of the packed group key
+            bool byAge = false, byGender = false, byLifestyle = false, byGroup = false, byMethod = false;
+            for (const std::string& key : keys) {
+                if (key == "age") byAge = true;
+                else if (key == "gender") byGender = true;
+                else if (key == "lifestyle") byLifestyle = true;
+                else if (key == "group") byGroup = true;
+                else if (key == "method") byMethod = true;
+                else throw std::invalid_argument("Invalid group-by key " + key + ". Must be 'age', 'gender', 'lifestyle', 'group', or 'method'.");
+            }
+
+            // Build one partial hash table per worker over its range of users
+            size_t workers = workerCount(mylist.size());
+            std::vector<std::unordered_map<uint32_t, GroupStats>> partials(workers);
+            parallelRanges(mylist.size(), workers, [&](size_t begin, size_t end, size_t worker) {
+                std::unordered_map<uint32_t, GroupStats>& table = partials[worker];
+                for (size_t i = begin; i < end; ++i) {
+                    const UserInfo& user = mylist[i];
+                    if (user.deleted) continue;
+                    uint32_t group = labelCode(bfpGroupNames, user.bfp.second);
+                    uint32_t key = 0;
+                    if (byAge) key |= ageBandCode(user.age);
+                    if (byGender) key |= uint32_t(user.genderCode) << 8;
+                    if (byLifestyle) key |= uint32_t(user.lifestyleCode) << 16;
+                    if (byGroup) key |= group << 24;
+                    if (byMethod) key |= methodCode(group) << 28;
+
+                    GroupStats& stats = table[key];
+                    stats.count++;
+                    stats.bfp.add(user.bfp.first);
+                    stats.calories.add(user.calories);
+                    stats.carbs.add(user.carbs);
+                    stats.protein.add(user.protein);
+                    stats.fat.add(user.fat);
+                }
+            });
+
+            // Merge the partial tables into the first one
+            std::unordered_map<uint32_t, GroupStats>& merged = partials[0];
+            for (size_t worker = 1; worker < workers; ++worker) {
+                for (auto& entry : partials[worker]) {
+                    GroupStats& stats = merged[entry.first];
+                    stats.count += entry.second.count;
+                    stats.bfp.merge(entry.second.bfp);
+                    stats.calories.merge(entry.second.calories);
+                    stats.carbs.merge(entry.second.carbs);
+                    stats.protein.merge(entry.second.protein);
+                    stats.fat.merge(entry.second.fat);
+                }
+            }
+
+            // Decode the packed keys into labels and order the groups by key
+            std::vector<std::pair<uint32_t, GroupStats>> ordered(merged.begin(), merged.end());
+            std::sort(ordered.begin(), ordered.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+            std::vector<GroupStats> result;
+            for (auto& entry : ordered) {
+                GroupStats& stats = entry.second;
+                if (byAge) stats.ageBand = ageBands[entry.first & 0xFF];
+                if (byGender) stats.gender = genders[(entry.first >> 8) & 0xFF];
+                if (byLifestyle) stats.lifestyle = lifestyles[(entry.first >> 16) & 0xFF];
+                if (byGroup) stats.group = bfpGroupNames[(entry.first >> 24) & 0x0F];
+                if (byMethod) stats.method = methods[entry.first >> 28];
+                result.push_back(stats);
+            }
+            return result;
+        }
+
+        /** Gets the 'k' users with the highest (or lowest) value of a numeric field
+         * Each thread keeps a bounded heap of its best k users, and the heaps are merged at the end
+         * Returns (username, value) pairs ordered from best to worst
+         **/
+        std::vector<std::pair<std::string, double>> topUsers(const std::string& field, size_t k, bool highest=true) {
+            LatencyTimer timer("topUsers");
+            auto read = fieldReader(field);
+            // Orders candidates so that the heap top is the worst of the kept users
+            auto better = [highest](const std::pair<double, size_t>& a, const std::pair<double, size_t>& b) {
+                return highest ? a.first > b.first : a.first < b.first;
+            };
+
+            size_t workers = workerCount(mylist.size());
+            std::vector<std::vector<std::pair<double, size_t>>> heaps(workers);
+            parallelRanges(mylist.size(), workers, [&](size_t begin, size_t end, size_t worker) {
+                std::vector<std::pair<double, size_t>>& heap = heaps[worker];
+                for (size_t i = begin; i < end && k > 0; ++i) {
+                    if (mylist[i].deleted) continue;
+                    std::pair<double, size_t> candidate = {read(mylist[i]), i};
+                    if (heap.size() < k) {
+                        heap.push_back(candidate);
+                        std::push_heap(heap.begin(), heap.end(), better);
+                    } else if (better(candidate, heap.front())) {
+                        std::pop_heap(heap.begin(), heap.end(), better);
+                        heap.back() = candidate;
+                        std::push_heap(heap.begin(), heap.end(), better);
+                    }
+                }
+            });
+
+            // Merge the per-thread heaps and keep the best k overall
+            std::vector<std::pair<double, size_t>> candidates;
+            for (const auto& heap : heaps) {
+                candidates.insert(candidates.end(), heap.begin(), heap.end());
+            }
+            size_t kept = std::min(k, candidates.size());
+            std::partial_sort(candidates.begin(), candidates.begin() + kept, candidates.end(), better);
+
+            std::vector<std::pair<std::string, double>> result;
+            for (size_t i = 0; i < kept; ++i) {
+                result.push_back({std::string(nameOf(mylist[candidates[i].second])), candidates[i].first});
+            }
+            return result;
+        }
+
+        /** Gets the exact values of a numeric field at the given percentiles (0 to 100) for a cohort
+         * The cohort is all users, optionally restricted to one gender and/or one age band (e.g. "40-59")
+         * Uses nearest-rank percentiles selected with nth_element, so no full sort is needed
+         * Throws a runtime error if the cohort is empty
+         **/
+        std::vector<double> percentiles(const std::string& field, std::vector<double> ps, const std::string& gender="", const std::string& ageBand="") {
+            LatencyTimer timer("percentiles");
+            auto read = fieldReader(field);
+            std::vector<double> values;
+            for (const UserInfo& user : mylist) {
+                if (!user.deleted && inCohort(user, gender, ageBand)) values.push_back(read(user));
+            }
+            if (values.empty()) {
+                throw std::runtime_error("Cannot compute a percentile of an empty set of users.");
+            }
+
+            // Select the ranks in increasing order so each nth_element only searches the remaining range
+            std::vector<size_t> order(ps.size());
+            for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+            std::sort(order.begin(), order.end(), [&ps](size_t a, size_t b) { return ps[a] < ps[b]; });
+
+            std::vector<double> result(ps.size());
+            auto low = values.begin();
+            for (size_t i : order) {
+                double p = std::clamp(ps[i], 0.0, 100.0);
+                size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * values.size()));
+                auto nth = values.begin() + (rank == 0 ? 0 : rank - 1);
+                std::nth_element(low, nth, values.end());
+                result[i] = *nth;
+                low = nth;
+            }
+            return result;
+        }
+
+        /** Builds an approximate quantile sketch of a numeric field for a cohort (see percentiles for the cohort)
+         * Each thread sketches its range of users and the sketches are merged, so memory stays bounded
+         * The returned sketch can be queried repeatedly for any percentile without touching the users again
+         **/
+        QuantileSketch sketch(const std::string& field, const std::string& gender="", const std::string& ageBand="", size_t accuracy=400) {
+            LatencyTimer timer("sketch");
+            auto read = fieldReader(field);
+            size_t workers = workerCount(mylist.size());
+            std::vector<QuantileSketch> partials(workers, QuantileSketch(accuracy));
+            parallelRanges(mylist.size(), workers, [&](size_t begin, size_t end, size_t worker) {
+                for (size_t i = begin; i < end; ++i) {
+                    if (!mylist[i].deleted && inCohort(mylist[i], gender, ageBand)) partials[worker].add(read(mylist[i]));
+                }
+            });
+            for (size_t worker = 1; worker < workers; ++worker) {
+                partials[0].merge(partials[worker]);
+            }
+            return partials[0];
+        }
+
+        /** Counts of users and healthy users per method and gender, from the per-method columns
+         * 'agree' counts users that both methods classify the same way (healthy or not)
+         **/
+        struct MethodComparison {
+            long long totalMale=0;
+            long long totalFemale=0;
+            long long healthyUsNavyMale=0;
+            long long healthyUsNavyFemale=0;
+            long long healthyBmiMale=0;
+            long long healthyBmiFemale=0;
+            long long agree=0;
+        };
+
+        /** Compares the US Navy and BMI columns of every user in a single scan
+         * Requires the per-method columns to have been filled by CombinedMethod
+         * Throws a runtime error if a user has no result for either method
+         **/
+        MethodComparison compareMethods() {
+            LatencyTimer timer("compareMethods");
+            MethodComparison result;
+            for (const UserInfo& user : mylist) {
+                if (user.deleted) continue;
+                if (user.usNavyBfp.second == "none" || user.bmiBfp.second == "none") {
+                    throw std::runtime_error("Body fat percentage has not been calculated with both methods for all users.");
+                }
+                bool male = user.genderCode == 1;
+                bool healthyUsNavy = user.usNavyBfp.second == "normal";
+                bool healthyBmi = user.bmiBfp.second == "healthy weight";
+                (male ? result.totalMale : result.totalFemale)++;
+                if (healthyUsNavy) (male ? result.healthyUsNavyMale : result.healthyUsNavyFemale)++;
+                if (healthyBmi) (male ? result.healthyBmiMale : result.healthyBmiFemale)++;
+                if (healthyUsNavy == healthyBmi) result.agree++;
+            }
+            return result;
+        }
+
+        /** One user matched by name across two populations, with both sides' metrics
+         **/
+        struct JoinedUser {
+            std::string name;
+            std::string gender;
+            int age=0;
+            std::pair<int, std::string> bfp={0, "none"};
+            std::pair<int, std::string> otherBfp={0, "none"};
+            double calories=0;
+            double otherCalories=0;
+        };
+
+        /** Result of joinByName
+         * 'disagreements' counts matched users per (this class, other class) pair, indexed by healthClass codes
+         **/
+        struct JoinResult {
+            std::vector<JoinedUser> users;
+            long long disagreements[4][4]={};
+        };
+
+        /** Maps a bfp group from either method to a coarse class comparable across methods
+         * 0 = none, 1 = low (low, underweight), 2 = healthy (normal, healthy weight), 3 = high (everything above)
+         **/
+        static int healthClass(const std::string& group) {
+            if (group == "low" || group == "underweight") return 1;
+            if (group == "normal" || group == "healthy weight") return 2;
+            if (group == "none") return 0;
+            return 3;
+        }
+        inline static const std::vector<std::string> healthClasses = { "none", "low", "healthy", "high" };
+
+        /** Matches the users of this manager with the users of 'other' by name using a partitioned hash join
+         * Both sides are hash-partitioned in parallel, then each partition builds a table on this side and probes it with 'other'
+         * If a name appears more than once in this manager, the first occurrence is matched (like findUser)
+         * Returns the matched users in this manager's order, and counts users whose health class differs between the two sides
+         **/
+        JoinResult joinByName(const UserInfoManager& other) const {
+            LatencyTimer timer("joinByName");
+            const size_t partitionCount = 64;
+            size_t workers = workerCount(mylist.size() + other.mylist.size());
+
+            // Hash-partition the row positions of one side; each worker fills its own set of partitions
+            auto partition = [&](const UserInfoManager& side) {
+                const std::vector<UserInfo>& users = side.mylist;
+                std::vector<std::vector<std::vector<size_t>>> parts(workers, std::vector<std::vector<size_t>>(partitionCount));
+                parallelRanges(users.size(), workers, [&](size_t begin, size_t end, size_t worker) {
+                    for (size_t i = begin; i < end; ++i) {
+                        if (users[i].deleted) continue;
+                        size_t hash = std::hash<std::string_view>()(side.nameOf(users[i]));
+                        parts[worker][hash % partitionCount].push_back(i);
+                    }
+                });
+                return parts;
+            };
+            auto buildParts = partition(*this);
+            auto probeParts = partition(other);
+
+            // Join each partition independently: build on this side, probe with the other side
+            std::vector<std::vector<std::pair<size_t, size_t>>> matches(partitionCount);
+            parallelRanges(partitionCount, std::min(workers, partitionCount), [&](size_t begin, size_t end, size_t) {
+                for (size_t p = begin; p < end; ++p) {
+                    std::unordered_map<std::string_view, size_t> table;
+                    for (size_t worker = 0; worker < workers; ++worker) {
+                        for (size_t i : buildParts[worker][p]) {
+                            auto found = table.find(nameOf(mylist[i]));
+                            if (found == table.end()) table.emplace(nameOf(mylist[i]), i);
+                            else found->second = std::min(found->second, i);
+                        }
+                    }
+                    for (size_t worker = 0; worker < workers; ++worker) {
+                        for (size_t j : probeParts[worker][p]) {
+                            auto found = table.find(other.nameOf(other.mylist[j]));
+                            if (found != table.end()) matches[p].push_back({found->second, j});
+                        }
+                    }
+                }
+            });
+
+            // Concatenate the partitions back into this manager's order and build the report
+            std::vector<std::pair<size_t, size_t>> ordered;
+            for (const auto& partitionMatches : matches) {
+                ordered.insert(ordered.end(), partitionMatches.begin(), partitionMatches.end());
+            }
+            std::sort(ordered.begin(), ordered.end());
+
+            JoinResult result;
+            result.users.reserve(ordered.size());
+            for (const auto& match : ordered) {
+                const UserInfo& user = mylist[match.first];
+                const UserInfo& otherUser = other.mylist[match.second];
+                result.users.push_back({std::string(nameOf(user)), user.gender, user.age, user.bfp, otherUser.bfp, user.calories, otherUser.calories});
+                int mine = healthClass(user.bfp.second);
+                int theirs = healthClass(otherUser.bfp.second);
+                if (mine != theirs) result.disagreements[mine][theirs]++;
+            }
+            return result;
+        }
+
+        /** Getter methods to access user information
+         * Public member since other classes need to access user information
+         * Necessary since the 'mylist' vector and UserInfo struct are private to UserInfoManager
+         **/
+        int getAge(const std::string& username) { return findUser(username).age; }
+        const std::string& getGender(const std::string& username) { return findUser(username).gender; }
+        double getWeight(const std::string& username) { return findUser(username).weight; }
+        double getWaist(const std::string& username) { return findUser(username).waist; }
+        double getNeck(const std::string& username) { return findUser(username).neck; }
+        double getHeight(const std::string& username) { return findUser(username).height; }
+        double getHip(const std::string& username) { return findUser(username).hip; }
+        std::pair<int, std::string> getBfp(const std::string& username) { return findUser(username).bfp; }
+        double getCalories(const std::string& username) { return findUser(username).calories; }
+        const std::string& getLifestyle(const std::string& username) { return findUser(username).lifestyle; }
+
+        /** Setter methods to access user information
+         * Public member since other classes need to update user information
+         * Necessary since the 'mylist' vector and UserInfo struct are private to UserInfoManager
+         * Setting a result forgets the user's fingerprint, so the next massLoadAndCompute calculates the user again
+         **/
+        void setBfp(const std::string& username, std::pair<int, std::string> bfp) {
+            rescore(username, [&](UserInfo& user) { user.bfp = bfp; user.exactBfp = bfp.first; user.roundedBfp = true; user.fingerprint = 0; });
+            journalRecord("set," + username + ",bfp," + std::to_string(bfp.first) + "," + bfp.second);
+        }
+        void setCalories(const std::string& username, double calories) {
+            rescore(username, [&](UserInfo& user) { user.calories = calories; user.fingerprint = 0; });
+            journalRecord("set," + username + ",calories," + exact(calories));
+        }
+        void setCarbs(const std::string& username, double carbs) {
+            rescore(username, [&](UserInfo& user) { user.carbs = carbs; user.fingerprint = 0; });
+            journalRecord("set," + username + ",carbs," + exact(carbs));
+        }
+        void setProtein(const std::string& username, double protein) {
+            rescore(username, [&](UserInfo& user) { user.protein = protein; user.fingerprint = 0; });
+            journalRecord("set," + username + ",protein," + exact(protein));
+        }
+        void setFat(const std::string& username, double fat) {
+            rescore(username, [&](UserInfo& user) { user.fat = fat; user.fingerprint = 0; });
+            journalRecord("set," + username + ",fat," + exact(fat));
+        }
+        void setLifestyle(const std::string& username, std::string lifestyle) {
+            rescore(username, [&](UserInfo& user) {
+                user.lifestyle = lifestyle;
+                encodeCategories(user);
+            });
+            journalRecord("set," + username + ",lifestyle," + lifestyle);
+        }
+
+        /** Calls fn(user) for the user with the given name, with a single lookup
+         * 'fn' must be a generic lambda since the UserInfo type is private to the UserInfoManager
+         * 'fn' may update computed results (bfp, calories, macros) but not gender or lifestyle
+         * Throws a runtime error if the user is not found
+         **/
+        template <typename Fn>
+        void updateUser(const std::string& username, Fn fn) {
+            LatencyTimer timer("updateUser");
+            rescore(username, fn);
+        }
+
+        /** Gets a user's .csv row in the format of writeToFile
+         * Throws a runtime error if the user is not found
+         **/
+        std::string userRow(const std::string& username) {
+            LatencyTimer timer("userRow");
+            return csvRow(findUser(username));
+        }
+
+        /** Gets the .csv rows of several users, in the format of writeToFile
+         * All names are looked up in one pass over the name index before any row is formatted
+         * rows[i] is the row of usernames[i], and found[i] is false if that user does not exist
+         **/
+        void userRows(const std::vector<std::string_view>& usernames, std::vector<std::string>& rows, std::vector<bool>& found) {
+            LatencyTimer timer("userRows");
+            std::vector<size_t> positions(usernames.size(), mylist.size());
+            // The index is keyed by views into the name arena, so the requested names are looked up as they are, without a copy
+            for (size_t i = 0; i < usernames.size(); ++i) {
+                auto entry = nameIndex.find(usernames[i]);
+                if (entry != nameIndex.end()) positions[i] = entry->second;
+            }
+            rows.resize(usernames.size());
+            found.assign(usernames.size(), false);
+            for (size_t i = 0; i < usernames.size(); ++i) {
+                rows[i].clear();
+                if (positions[i] == mylist.size()) continue;
+                appendCsvRow(rows[i], mylist[positions[i]], 6);
+                found[i] = true;
+            }
+        }
+
+        /** Calls fn(user) for every user, splitting the users across threads for large populations
+         * 'fn' must be a generic lambda since the UserInfo type is private to the UserInfoManager
+         * 'fn' runs concurrently on disjoint users, and may update computed results but not gender or lifestyle
+         **/
+        template <typename Fn>
+        void forEachUser(Fn fn) {
+            LatencyTimer timer("forEachUser");
+            // Each worker collects its changes to the aggregates and views separately; they are applied once all workers are done
+            size_t workers = workerCount(mylist.size());
+            std::vector<LiveStats> changes(workers);
+            std::vector<std::vector<ViewChange>> viewChanges(workers);
+            parallelRanges(mylist.size(), workers, [&](size_t begin, size_t end, size_t worker) {
+                LiveStats& change = changes[worker];
+                for (size_t i = begin; i < end; ++i) {
+                    if (mylist[i].deleted) continue;
+                    change.apply(mylist[i], -1);
+                    fn(mylist[i]);
+                    change.apply(mylist[i], 1);
+                    for (auto& view : views) {
+                        bool member = inView(view.second, mylist[i]);
+                        if (member != (view.second.members.count(i) > 0)) viewChanges[worker].push_back({&view.second, i, member});
+                    }
+                }
+            });
+            for (const LiveStats& change : changes) live.merge(change);
+            for (const std::vector<ViewChange>& worker : viewChanges) {
+                for (const ViewChange& change : worker) {
+                    if (change.member) change.view->members.insert(change.position);
+                    else change.view->members.erase(change.position);
+                }
+            }
+        }
+
+        /** Re-buckets every user's stored bfp into the groups of 'thresholds' in one parallel pass, without recomputing any bfp
+         * The method of each user follows from its current group; users whose bfp was not calculated are left alone
+         * A bfp read from a file is only known to the whole number, so a group boundary within that unit keeps the stored group
+         * CombinedMethod's per-method columns keep their groups; only the primary bfp column is re-bucketed
+         * Returns the number of users whose group changed
+         **/
+        size_t reclassify(const BfpThresholds& thresholds) {
+            LatencyTimer timer("reclassify");
+            std::atomic<size_t> changed{0};
+            forEachUser([&](UserInfo& user) {
+                uint32_t code = labelCode(bfpGroupNames, user.bfp.second);
+                uint32_t method = methodCode(code);
+                if (method == 0) return;
+                auto bucketOf = [&](double bfp) {
+                    return (method == 1) ? thresholds.usNavyBucket(bfp, user.age, user.genderCode) : thresholds.bmiBucket(bfp);
+                };
+                int position;
+                if (!user.roundedBfp) {
+                    position = bucketOf(user.exactBfp);
+                } else {
+                    // Only the whole number is known, so the bfp lies within one unit of it (rounded towards zero);
+                    // the stored group is kept as long as some bfp in that range still falls in it
+                    double whole = user.bfp.first;
+                    double low = (whole > 0) ? whole : std::nextafter(whole - 1.0, whole);
+                    double high = (whole < 0) ? whole : std::nextafter(whole + 1.0, whole);
+                    position = std::clamp(static_cast<int>(code) - ((method == 1) ? 1 : 5), bucketOf(low), bucketOf(high));
+                }
+                const std::string& group = (method == 1) ? BfpThresholds::usNavyGroupName(position) : BfpThresholds::bmiGroupName(position);
+                if (group == user.bfp.second) return;
+                user.bfp.second = group;
+                changed.fetch_add(1, std::memory_order_relaxed);
+            });
+            return changed.load();
+        }
+
+        /** Returns a hash of a user's inputs (age, measurements, and the gender and lifestyle codes the results depend on) and 'salt'
+         * 'salt' identifies how the results were calculated (see HealthAssistant::fingerprintSalt); the hash is never 0
+         **/
+        static uint64_t fingerprintOf(const UserInfo& user, uint64_t salt) {
+            uint64_t hash = fingerprintMix(salt, uint64_t(static_cast<uint32_t>(user.age)) | uint64_t(user.genderCode) << 32 | uint64_t(user.lifestyleCode) << 40);
+            hash = fingerprintMix(hash, user.weight);
+            hash = fingerprintMix(hash, user.waist);
+            hash = fingerprintMix(hash, user.neck);
+            hash = fingerprintMix(hash, user.height);
+            hash = fingerprintMix(hash, user.hip);
+            return (hash == 0) ? 1 : hash;
+        }
+
+        /** Records that a user's results were calculated from its current inputs
+         * Throws a runtime error if the user is not found
+         **/
+        void stampFingerprint(const std::string& username, uint64_t salt) {
+            UserInfo& user = findUser(username);
+            user.fingerprint = fingerprintOf(user, salt);
+        }
+
+        /** Records that every user's results were calculated from its current inputs
+         **/
+        void stampFingerprints(uint64_t salt) {
+            parallelRanges(mylist.size(), workerCount(mylist.size()), [&](size_t begin, size_t end, size_t) {
+                for (size_t i = begin; i < end; ++i) {
+                    if (!mylist[i].deleted) mylist[i].fingerprint = fingerprintOf(mylist[i], salt);
+                }
+            });
+        }
+
+        /** Gets the positions of the users whose stored fingerprint does not match their inputs, i.e. whose results are stale
+         **/
+        std::vector<size_t> staleUsers(uint64_t salt) {
+            LatencyTimer timer("staleUsers");
+            size_t workers = workerCount(mylist.size());
+            std::vector<std::vector<size_t>> stale(workers);
+            parallelRanges(mylist.size(), workers, [&](size_t begin, size_t end, size_t worker) {
+                for (size_t i = begin; i < end; ++i) {
+                    if (!mylist[i].deleted && mylist[i].fingerprint != fingerprintOf(mylist[i], salt)) stale[worker].push_back(i);
+                }
+            });
+            std::vector<size_t> positions;
+            for (const std::vector<size_t>& part : stale) positions.insert(positions.end(), part.begin(), part.end());
+            return positions;
+        }
+
+        /** Copies the users at 'positions' into a new UserInfoManager, e.g. to calculate them apart from the others
+         **/
+        UserInfoManager copyUsers(const std::vector<size_t>& positions) const {
+            UserInfoManager copy;
+            for (size_t position : positions) {
+                UserInfo user = mylist[position];
+                user.name = copy.names.store(nameOf(mylist[position]));
+                copy.appendUser(std::move(user));
+            }
+            return copy;
+        }
+
+        /** Takes the calculated results of the users copied by copyUsers(positions) back into the users at 'positions'
+         **/
+        void mergeResults(const UserInfoManager& calculated, const std::vector<size_t>& positions) {
+            for (size_t i = 0; i < positions.size(); ++i) {
+                const UserInfo& from = calculated.mylist[i];
+                retract(positions[i]);
+                UserInfo& user = mylist[positions[i]];
+                user.bfp = from.bfp;
+                user.exactBfp = from.exactBfp;
+                user.roundedBfp = from.roundedBfp;
+                user.usNavyBfp = from.usNavyBfp;
+                user.bmiBfp = from.bmiBfp;
+                user.calories = from.calories;
+                user.carbs = from.carbs;
+                user.protein = from.protein;
+                user.fat = from.fat;
+                user.fingerprint = from.fingerprint;
+                admit(positions[i]);
+            }
+        }
+
+        /** Removes every user failing pred(user), e.g. the users a filter rejects once their results are calculated
+         * The survivors are moved into a fresh list in order; nothing is journaled, like a file load
+         **/
+        template <typename Pred>
+        void retainUsers(Pred pred) {
+            std::vector<size_t> kept;
+            for (size_t i = 0; i < mylist.size(); ++i) {
+                if (!mylist[i].deleted && pred(std::as_const(mylist[i]))) kept.push_back(i);
+            }
+            if (kept.size() == userCount()) return;
+            UserInfoManager survivors = copyUsers(kept);
+            resetUsers();
+            for (UserInfo& user : survivors.mylist) {
+                user.name = names.store(survivors.nameOf(user));
+                appendUser(std::move(user));
+            }
+        }
+
+        /** Checks whether the header of a .csv file has a fingerprint column
+         * Returns false if the file cannot be read, leaving the error to the read that follows
+         **/
+        static bool hasFingerprints(const std::string& filename) {
+            std::ifstream file(filename);
+            std::string line;
+            if (!std::getline(file, line)) return false;
+            std::vector<std::string_view> header;
+            splitRow(line, header, std::count(line.begin(), line.end(), ',') + 1);
+            return std::any_of(header.begin(), header.end(), [](std::string_view column) { return fieldOfColumn(column) == fingerprintColumn; });
+        }
+
+
+        /** Reads user information from a .csv file and populates the 'mylist' vector
+         * Columns are matched by the names in the header line, so reordered or extra columns are read correctly
+         * Files without a header line are read with the first generation layout (gender,age,weight,waist,neck,hip,height,lifestyle)
+         * If 'columns' is given, only those columns (see csvColumns) are converted and stored; the others keep their defaults
+         * If 'filter' is given, it is tested on the raw fields of each row and failing rows are dropped before anything is stored
+         * Throws a runtime error if the file cannot be opened or is not a .csv file
+         **/
+        void readFromFile(std::string filename, const std::vector<std::string>& columns={}, const ScanFilter& filter=ScanFilter()) {
+            LatencyTimer timer("readFromFile");
+            readFromFileInChunks(filename, std::numeric_limits<size_t>::max(), [](UserInfoManager&) {}, columns, filter);
+        }
+
+        /** Reads a .csv file like readFromFile, but hands the users over 'rowsPerChunk' at a time
+         * fn(*this) is called whenever 'mylist' holds a full chunk, and once more for the last partial chunk
+         * The users are cleared after each call, so at most one chunk is held in memory
+         * Throws a runtime error if the file cannot be opened or is not a .csv file
+         **/
+        template <typename Fn>
+        void readFromFileInChunks(std::string filename, size_t rowsPerChunk, Fn fn, const std::vector<std::string>& columns={}, const ScanFilter& filter=ScanFilter()) {
+            uint32_t projection = projectionMask(columns);
+            uint32_t filterColumns = filter.columns();
+
+            // Check if the file extension is .csv
+            std::string extension = ".csv";
+            if (filename.size() <= extension.size() || filename.substr(filename.size() - extension.size()) != extension) {
+                throw std::runtime_error("File " + filename + " is not a .csv file. The Health Assistant can only read .csv files.");
+            }
+
+            // Attempt to open the file
+            std::ifstream file;
+            {
+                TraceSpan span("open file", "io");
+                file.open(filename);
+            }
+            if (!file) {
+                throw std::runtime_error("Could not open file " + filename);
+            }
+
+            resetUsers();
+
+            // The plan is compiled from the first line, then drives every row; filter columns are mapped too so they can be tested
+            bool first = true;
+            ParsePlan plan;
+            ParsePlan filterPlan;
+            std::vector<std::string_view> fields;
+            auto readRow = [&](std::string_view line) {
+                splitRow(line, fields, std::max(plan.span, filterPlan.span));
+                if (filterColumns != 0) {
+                    auto field = [&](int column) { return (filterPlan.sources[column] >= 0) ? fields[filterPlan.sources[column]] : std::string_view(); };
+                    if (!filter.matches(field(1), parseNumber<int>(field(2)), field(14), field(9))) return;
+                }
+                appendUser(buildUser(fields, plan));
+                if (mylist.size() >= rowsPerChunk) {
+                    fn(*this);
+                    resetUsers();
+                }
+            };
+
+            forEachLine(file, [&](std::string_view line) {
+                // Blank lines, e.g. a trailing one or a stray "\r", hold no user
+                if (line.find_first_not_of(" \t\r") == std::string_view::npos) return;
+                if (!first) { readRow(line); return; }
+                first = false;
+
+                // Read the header line if there is one; otherwise use the first generation layout and treat the line as a user
+                std::vector<std::string_view> header;
+                splitRow(line, header, std::count(line.begin(), line.end(), ',') + 1);
+                size_t known = std::count_if(header.begin(), header.end(), [](std::string_view column) { return fieldOfColumn(column) >= 0; });
+                bool hasHeader = known * 2 > header.size();
+                std::vector<std::string> columnNames = hasHeader ? std::vector<std::string>(header.begin(), header.end()) : headerlessColumns;
+                plan = compilePlan(columnNames, projection);
+                filterPlan = compilePlan(columnNames, filterColumns);
+                if (!hasHeader) readRow(line);
+            });
+
+            // Hand over the last partial chunk; a whole-file read keeps its users loaded
+            if (rowsPerChunk != std::numeric_limits<size_t>::max() && !mylist.empty()) {
+                fn(*this);
+                resetUsers();
+            }
+        }
+
+        /** Overwrites the .csv file provided with the user information in the 'mylist' vector
+         *  Numbers are written with 'precision' significant digits (6 matches the default stream output)
+         *  Rows are formatted in parallel into one reusable buffer per thread, then the buffers are written in order
+         *  Throws a runtime error if the file cannot be opened or is not a .csv file
+         **/
+        void writeToFile(std::string filename, int precision=6) {
+            LatencyTimer timer("writeToFile");
+            // Check if the file extension is .csv
+            std::string extension = ".csv";
+            if (filename.size() <= extension.size() || filename.substr(filename.size() - extension.size()) != extension) {
+                throw std::runtime_error("File " + filename + " is not a .csv file. The Health Assistant can only write to .csv files.");
+            }
+
+            // Attempt to open the file
+            std::ofstream file(filename);
+            if (!file) {
+                throw std::runtime_error("Could not open file " + filename);
+            }
+
+            // Write the header line
+            file << "name,gender,age,weight,waist,neck,height,hip,bfp,group,calories,carbs,protein,fat,lifestyle,fingerprint\n";
+            writeRows(file, precision);
+            if (!file) {
+                throw std::runtime_error("Could not write file " + filename);
+            }
+        }
+
+        /** Writes the .csv rows of all users (without the header line) to 'file', in the format of writeToFile
+         * Lets a caller write one file from several batches of users
+         **/
+        void writeRows(std::ostream& file, int precision=6) {
+            // Format rounds of rows, one contiguous block per thread, and write the blocks in order
+            const size_t rowsPerBuffer = 16384;
+            size_t workers = workerCount(mylist.size());
+            std::vector<std::string> buffers(workers);
+            for (size_t start = 0; start < mylist.size(); start += workers * rowsPerBuffer) {
+                size_t rows = std::min(mylist.size() - start, workers * rowsPerBuffer);
+                parallelRanges(rows, workers, [&](size_t begin, size_t end, size_t worker) {
+                    std::string& buffer = buffers[worker];
+                    buffer.clear();
+                    for (size_t i = start + begin; i < start + end; ++i) {
+                        if (mylist[i].deleted) continue;
+                        appendCsvRow(buffer, mylist[i], precision);
+                        buffer += '\n';
+                    }
+                });
+                TraceSpan span("write block", "io");
+                for (const std::string& buffer : buffers) {
+                    file.write(buffer.data(), buffer.size());
+                }
+            }
+        }
+
+        /** Overwrites the .jsonl file provided with one JSON object per user
+         * Rows are formatted into a single reusable buffer that is flushed whenever it fills, so no per-row allocation is made
+         * Numbers are written in their shortest exact form; non-finite numbers are written as null
+         * Throws a runtime error if the file cannot be opened or is not a .jsonl file
+         **/
+        void writeJsonLines(std::string filename) {
+            LatencyTimer timer("writeJsonLines");
+            // Check if the file extension is .jsonl
+            std::string extension = ".jsonl";
+            if (filename.size() <= extension.size() || filename.substr(filename.size() - extension.size()) != extension) {
+                throw std::runtime_error("File " + filename + " is not a .jsonl file.");
+            }
+
+            // Attempt to open the file
+            std::ofstream file(filename, std::ios::binary);
+            if (!file) {
+                throw std::runtime_error("Could not open file " + filename);
+            }
+
+            const size_t flushSize = 1 << 20;
+            std::string buffer;
+            buffer.reserve(2 * flushSize);
+            auto text = [&buffer](const char* key, std::string_view value) {
+                buffer += key;
+                buffer += '"';
+                for (char c : value) {
+                    if (c == '"' || c == '\\') { buffer += '\\'; buffer += c; }
+                    else if (static_cast<unsigned char>(c) < 0x20) {
+                        char escaped[8];
+                        std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                        buffer += escaped;
+                    }
+                    else buffer += c;
+                }
+                buffer += '"';
+            };
+            auto number = [&buffer](const char* key, double value) {
+                buffer += key;
+                if (std::isfinite(value)) appendNumber(buffer, value, 0);
+                else buffer += "null";
+            };
+
+            for (const UserInfo& user : mylist) {
+                if (user.deleted) continue;
+                text("{\"name\":", nameOf(user));
+                text(",\"gender\":", user.gender);
+                number(",\"age\":", user.age);
+                number(",\"weight\":", user.weight);
+                number(",\"waist\":", user.waist);
+                number(",\"neck\":", user.neck);
+                number(",\"height\":", user.height);
+                number(",\"hip\":", user.hip);
+                number(",\"bfp\":", user.bfp.first);
+                text(",\"group\":", user.bfp.second);
+                number(",\"calories\":", user.calories);
+                number(",\"carbs\":", user.carbs);
+                number(",\"protein\":", user.protein);
+                number(",\"fat\":", user.fat);
+                text(",\"lifestyle\":", user.lifestyle);
+                buffer += "}\n";
+                if (buffer.size() >= flushSize) {
+                    file.write(buffer.data(), buffer.size());
+                    buffer.clear();
+                }
+            }
+            file.write(buffer.data(), buffer.size());
+            if (!file) {
+                throw std::runtime_error("Could not write file " + filename);
+            }
+        }
+
+        /** Overwrites the .hacol file provided with a self-describing columnar binary export of all users
+         * Layout (native byte order):
+         *   header:    "HACOL1" + 2 zero bytes, uint32 column count, then per column: uint8 type, uint8 name length, name,
+         *              and for category columns uint8 label count followed by (uint8 length, label) per label
+         *   row group: uint64 row count, then each column's values for those rows, in header order
+         *              int32 = 4 bytes per row, float64 and uint64 = 8 bytes per row, category = 1 code byte per row,
+         *              string = (rows + 1) uint32 offsets into the group's string bytes, then the bytes
+         *   end:       a row group with a row count of 0
+         * Row groups hold at most 'rowsPerGroup' rows, so memory stays bounded by one group's column buffers
+         * Besides the .csv columns, the fingerprint, the unrounded bfp (NaN if only the rounded one is known)
+         * and CombinedMethod's per-method results are kept, so a round trip loses nothing reclassify or a recompute reads
+         * Throws a runtime error if the file cannot be opened or is not a .hacol file
+         **/
+        void writeColumnar(std::string filename, size_t rowsPerGroup=65536) {
+            LatencyTimer timer("writeColumnar");
+            // Check if the file extension is .hacol
+            std::string extension = ".hacol";
+            if (filename.size() <= extension.size() || filename.substr(filename.size() - extension.size()) != extension) {
+                throw std::runtime_error("File " + filename + " is not a .hacol file.");
+            }
+
+            // Attempt to open the file
+            std::ofstream file(filename, std::ios::binary);
+            if (!file) {
+                throw std::runtime_error("Could not open file " + filename);
+            }
+
+            // Write the schema header
+            std::string header("HACOL1\0\0", 8);
+            appendRaw(header, static_cast<uint32_t>(columnarSchema.size()));
+            for (const ColumnSpec& column : columnarSchema) {
+                header += static_cast<char>(column.type);
+                header += static_cast<char>(column.name.size());
+                header += column.name;
+                if (column.type == ColumnType::Category) {
+                    header += static_cast<char>(column.labels->size());
+                    for (const std::string& label : *column.labels) {
+                        header += static_cast<char>(label.size());
+                        header += label;
+                    }
+                }
+            }
+            file.write(header.data(), header.size());
+
+            // Fill one buffer per column for each row group and write the buffers in schema order
+            rowsPerGroup = std::max<size_t>(1, rowsPerGroup);
+            std::vector<std::string> columns(columnarSchema.size());
+            std::string nameBytes;
+            size_t position = 0;
+            while (true) {
+                for (std::string& column : columns) column.clear();
+                nameBytes.clear();
+                uint64_t rows = 0;
+                uint32_t nameOffset = 0;
+                appendRaw(columns[0], nameOffset);
+                for (; position < mylist.size() && rows < rowsPerGroup; ++position) {
+                    const UserInfo& user = mylist[position];
+                    if (user.deleted) continue;
+                    std::string_view name = nameOf(user);
+                    nameBytes += name;
+                    nameOffset += name.size();
+                    appendRaw(columns[0], nameOffset);
+                    columns[1] += static_cast<char>(user.genderCode);
+                    appendRaw(columns[2], static_cast<int32_t>(user.age));
+                    appendRaw(columns[3], user.weight);
+                    appendRaw(columns[4], user.waist);
+                    appendRaw(columns[5], user.neck);
+                    appendRaw(columns[6], user.height);
+                    appendRaw(columns[7], user.hip);
+                    appendRaw(columns[8], static_cast<int32_t>(user.bfp.first));
+                    columns[9] += static_cast<char>(labelCode(bfpGroupNames, user.bfp.second));
+                    appendRaw(columns[10], user.calories);
+                    appendRaw(columns[11], user.carbs);
+                    appendRaw(columns[12], user.protein);
+                    appendRaw(columns[13], user.fat);
+                    columns[14] += static_cast<char>(user.lifestyleCode);
+                    appendRaw(columns[15], user.fingerprint);
+                    appendRaw(columns[16], user.roundedBfp ? std::numeric_limits<double>::quiet_NaN() : user.exactBfp);
+                    appendRaw(columns[17], static_cast<int32_t>(user.usNavyBfp.first));
+                    columns[18] += static_cast<char>(labelCode(bfpGroupNames, user.usNavyBfp.second));
+                    appendRaw(columns[19], static_cast<int32_t>(user.bmiBfp.first));
+                    columns[20] += static_cast<char>(labelCode(bfpGroupNames, user.bmiBfp.second));
+                    rows++;
+                }
+                file.write(reinterpret_cast<const char*>(&rows), sizeof(rows));
+                if (rows == 0) break;
+                for (size_t c = 0; c < columns.size(); ++c) {
+                    file.write(columns[c].data(), columns[c].size());
+                    if (c == 0) file.write(nameBytes.data(), nameBytes.size());
+                }
+            }
+            if (!file) {
+                throw std::runtime_error("Could not write file " + filename);
+            }
+        }
+
+        /** Replaces all users with the contents of a columnar export (see writeColumnar) held in memory
+         * Columns are matched by name, so columns that are unknown to this version are skipped
+         * 'source' names the data in error messages
+         * Throws a runtime error if the data is truncated or not in the columnar format
+         **/
+        void loadColumnar(const char* data, size_t size, const std::string& source) {
+            LatencyTimer timer("loadColumnar");
+            size_t position = 0;
+            auto need = [&](size_t bytes) {
+                if (size - position < bytes) {
+                    throw std::runtime_error("File " + source + " is truncated or not a columnar user file.");
+                }
+            };
+            auto read = [&](auto& value) {
+                need(sizeof(value));
+                std::memcpy(&value, data + position, sizeof(value));
+                position += sizeof(value);
+            };
+            auto readText = [&](size_t length) {
+                need(length);
+                std::string text(data + position, length);
+                position += length;
+                return text;
+            };
+
+            // Read the schema header
+            need(8);
+            if (std::memcmp(data, "HACOL1\0\0", 8) != 0) {
+                throw std::runtime_error("File " + source + " is not a columnar user file.");
+            }
+            position = 8;
+            struct Column {
+                ColumnType type;
+                int field;
+                std::vector<std::string> labels;
+            };
+            uint32_t columnCount = 0;
+            read(columnCount);
+            // Every column header takes at least its type and name length bytes
+            need(size_t(columnCount) * 2);
+            std::vector<Column> columns(columnCount);
+            for (Column& column : columns) {
+                uint8_t type = 0, nameLength = 0;
+                read(type);
+                read(nameLength);
+                column.type = static_cast<ColumnType>(type);
+                std::string name = readText(nameLength);
+                column.field = fieldOfColumn(name);
+                auto extra = std::find(columnarFields.begin(), columnarFields.end(), name);
+                if (column.field < 0 && extra != columnarFields.end()) column.field = csvColumns.size() + (extra - columnarFields.begin());
+                if (column.type == ColumnType::Category) {
+                    uint8_t labelCount = 0;
+                    read(labelCount);
+                    for (uint8_t i = 0; i < labelCount; ++i) {
+                        uint8_t labelLength = 0;
+                        read(labelLength);
+                        column.labels.push_back(readText(labelLength));
+                    }
+                }
+            }
+
+            // Fewest bytes a row takes over all columns, so a row count can be checked against the data before users are allocated
+            size_t rowBytes = 0;
+            for (const Column& column : columns) {
+                if (column.type == ColumnType::Float64 || column.type == ColumnType::UInt64) rowBytes += sizeof(double);
+                else if (column.type == ColumnType::Int32 || column.type == ColumnType::String) rowBytes += sizeof(uint32_t);
+                else if (column.type == ColumnType::Category) rowBytes += 1;
+            }
+            rowBytes = std::max<size_t>(1, rowBytes);
+            bool hasExactBfp = std::any_of(columns.begin(), columns.end(), [](const Column& column) { return column.field == 16; });
+
+            // Read the row groups column by column into new users
+            resetUsers();
+            while (true) {
+                uint64_t rows = 0;
+                read(rows);
+                if (rows == 0) break;
+                if (rows > (size - position) / rowBytes) {
+                    throw std::runtime_error("File " + source + " is truncated or not a columnar user file.");
+                }
+                size_t base = mylist.size();
+                mylist.resize(base + rows);
+                for (const Column& column : columns) {
+                    if (column.type == ColumnType::String) {
+                        need((rows + 1) * sizeof(uint32_t));
+                        const char* offsets = data + position;
+                        position += (rows + 1) * sizeof(uint32_t);
+                        uint32_t first = 0, last = 0;
+                        std::memcpy(&last, offsets + rows * sizeof(uint32_t), sizeof(uint32_t));
+                        need(last);
+                        for (size_t row = 0; row < rows && column.field == 0; ++row) {
+                            uint32_t next = 0;
+                            std::memcpy(&first, offsets + row * sizeof(uint32_t), sizeof(uint32_t));
+                            std::memcpy(&next, offsets + (row + 1) * sizeof(uint32_t), sizeof(uint32_t));
+                            if (first > next || next > last) {
+                                throw std::runtime_error("File " + source + " has invalid string offsets.");
+                            }
+                            mylist[base + row].name = names.store(std::string_view(data + position + first, next - first));
+                        }
+                        position += last;
+                    } else if (column.type == ColumnType::Category) {
+                        need(rows);
+                        for (size_t row = 0; row < rows; ++row) {
+                            uint8_t code = static_cast<uint8_t>(data[position + row]);
+                            const std::string& label = (code < column.labels.size()) ? column.labels[code] : bfpGroupNames.back();
+                            UserInfo& user = mylist[base + row];
+                            if (column.field == 1) user.gender = label;
+                            else if (column.field == 9) user.bfp.second = label;
+                            else if (column.field == 14) user.lifestyle = label;
+                            else if (column.field == 18) user.usNavyBfp.second = label;
+                            else if (column.field == 20) user.bmiBfp.second = label;
+                        }
+                        position += rows;
+                    } else if (column.type == ColumnType::Int32) {
+                        need(rows * sizeof(int32_t));
+                        for (size_t row = 0; row < rows; ++row) {
+                            int32_t value = 0;
+                            std::memcpy(&value, data + position + row * sizeof(int32_t), sizeof(int32_t));
+                            if (column.field == 2) mylist[base + row].age = value;
+                            else if (column.field == 8) mylist[base + row].bfp.first = value;
+                            else if (column.field == 17) mylist[base + row].usNavyBfp.first = value;
+                            else if (column.field == 19) mylist[base + row].bmiBfp.first = value;
+                        }
+                        position += rows * sizeof(int32_t);
+                    } else if (column.type == ColumnType::UInt64) {
+                        need(rows * sizeof(uint64_t));
+                        for (size_t row = 0; row < rows && column.field == fingerprintColumn; ++row) {
+                            std::memcpy(&mylist[base + row].fingerprint, data + position + row * sizeof(uint64_t), sizeof(uint64_t));
+                        }
+                        position += rows * sizeof(uint64_t);
+                    } else if (column.type == ColumnType::Float64) {
+                        need(rows * sizeof(double));
+                        double UserInfo::* member = nullptr;
+                        switch (column.field) {
+                            case 3: member = &UserInfo::weight; break;
+                            case 4: member = &UserInfo::waist; break;
+                            case 5: member = &UserInfo::neck; break;
+                            case 6: member = &UserInfo::height; break;
+                            case 7: member = &UserInfo::hip; break;
+                            case 10: member = &UserInfo::calories; break;
+                            case 11: member = &UserInfo::carbs; break;
+                            case 12: member = &UserInfo::protein; break;
+                            case 13: member = &UserInfo::fat; break;
+                            case 16: member = &UserInfo::exactBfp; break;
+                        }
+                        for (size_t row = 0; row < rows && member; ++row) {
+                            std::memcpy(&(mylist[base + row].*member), data + position + row * sizeof(double), sizeof(double));
+                        }
+                        position += rows * sizeof(double);
+                    } else {
+                        throw std::runtime_error("File " + source + " has a column of unknown type.");
+                    }
+                }
+
+                // Files without the unrounded bfp, and users whose was unknown (NaN), keep the rounded one
+                for (size_t i = base; i < mylist.size(); ++i) {
+                    UserInfo& user = mylist[i];
+                    user.roundedBfp = !hasExactBfp || std::isnan(user.exactBfp);
+                    if (user.roundedBfp) user.exactBfp = user.bfp.first;
+                }
+
+                // Index the new users like appendUser does
+                TraceSpan span("index rebuild", "index");
+                for (size_t i = base; i < mylist.size(); ++i) {
+                    encodeCategories(mylist[i]);
+                    admit(i);
+                    indexName(i);
+                }
+            }
+        }
+
+        /** Loads the last snapshot, replays the journal on top of it, then journals every later mutation
+         * addUserInfo, deleteUser and the setters append a record; batch computations (forEachUser) are not journaled
+         * Records are committed in groups of 'groupSize'; if 'compactEvery' is set, the journal is compacted after that many records
+         * A missing snapshot or journal counts as empty; a torn last record (no trailing newline) is ignored and cut off the file
+         * Throws a runtime error if the snapshot or journal cannot be read
+         **/
+        void openJournal(const std::string& snapshot, const std::string& journalFile, size_t groupSize=64, size_t compactEvery=0) {
+            LatencyTimer timer("openJournal");
+            journal.reset();
+            resetUsers();
+            if (std::ifstream(snapshot)) {
+                readFromFile(snapshot);
+            }
+
+            // Replay every complete record in the journal
+            std::ifstream replay(journalFile, std::ios::binary);
+            std::string record;
+            uintmax_t complete = 0;
+            while (std::getline(replay, record)) {
+                if (replay.eof()) break;
+                applyRecord(record);
+                complete += record.size() + 1;
+            }
+            replay.close();
+
+            // Cut off a torn last record, or the next record appended would be glued onto it
+            std::error_code error;
+            uintmax_t size = std::filesystem::file_size(journalFile, error);
+            if (!error && size > complete && ::truncate(journalFile.c_str(), complete) != 0) {
+                throw std::runtime_error("Could not truncate journal " + journalFile + ": " + std::strerror(errno));
+            }
+
+            journal = std::make_unique<MutationJournal>(journalFile, groupSize);
+            snapshotFile = snapshot;
+            this->compactEvery = compactEvery;
+        }
+
+        /** Makes all journaled mutations durable
+         **/
+        void commitJournal() {
+            LatencyTimer timer("commitJournal");
+            if (journal) journal->commit();
+        }
+
+        /** Writes a fresh snapshot of all users and empties the journal
+         * The snapshot is written to a temporary file and synced into place (see replaceFile) before the journal is truncated,
+         * so a crash leaves either the old snapshot with the full journal or the new snapshot
+         * Numbers are written with 17 significant digits so replaying the snapshot restores every double exactly
+         * Throws a runtime error if no journal is open
+         **/
+        void compactJournal() {
+            LatencyTimer timer("compactJournal");
+            if (!journal) {
+                throw std::runtime_error("No journal is open.");
+            }
+            journal->commit();
+            std::string temporary = snapshotFile + ".tmp.csv";
+            writeToFile(temporary, 17);
+            replaceFile(temporary, snapshotFile);
+            journal->truncate();
+        }
+
+        /** Commits and closes the journal; later mutations are no longer journaled
+         **/
+        void closeJournal() { journal.reset(); }
+
+        /** Displays user information for all users or a specific user
+         * Throws a runtime error if the user is not found
+         **/
+        void display(std::string username) {
+            LatencyTimer timer("display");
+            if (username == "all") {
+                std::cout << "\nDisplaying information for all users...\n";
+                displayPage(0, std::numeric_limits<size_t>::max(), "card");
+            } else {
+                std::cout << "\nDisplaying information for user " << username << "...\n";
+                displayDetails(findUser(username));
+            }
+            std::cout << "\nDone.\n\n";
+        }
+
+        /** Displays up to 'limit' users starting at the 'offset'-th user (deleted users are not counted)
+         * Format "card" prints the colored card of displayDetails; "table" prints a plain tab-separated table for piping
+         * The output is built in a reusable buffer and written to std::cout in large chunks
+         * Throws an invalid argument error if the format is not recognized
+         **/
+        void displayPage(size_t offset, size_t limit, const std::string& format="card") {
+            LatencyTimer timer("displayPage");
+            bool table = (format == "table");
+            if (!table && format != "card") {
+                throw std::invalid_argument("Invalid display format " + format + ". Must be either 'card' or 'table'.");
+            }
+            const size_t flushSize = 1 << 20;
+            renderBuffer.clear();
+            if (table) {
+                renderBuffer += "name\tgender\tage\tweight\twaist\tneck\theight\thip\tlifestyle\tbfp\tgroup\tcalories\tcarbs\tprotein\tfat\n";
+            }
+
+            size_t skipped = 0;
+            size_t shown = 0;
+            for (size_t i = 0; i < mylist.size() && shown < limit; ++i) {
+                const UserInfo& user = mylist[i];
+                if (user.deleted) continue;
+                if (skipped < offset) { skipped++; continue; }
+                if (table) appendTableRow(renderBuffer, user);
+                else appendDetails(renderBuffer, user);
+                shown++;
+                if (renderBuffer.size() >= flushSize) {
+                    std::cout.write(renderBuffer.data(), renderBuffer.size());
+                    renderBuffer.clear();
+                }
+            }
+            std::cout.write(renderBuffer.data(), renderBuffer.size());
+            renderBuffer.clear();
+        }
+
+        /** Displays user information for a specific user
+         **/
+        void displayDetails(const UserInfo& user) {
+            std::string card;
+            appendDetails(card, user);
+            std::cout.write(card.data(), card.size());
+        }
+
+    private:
+
+        // Reusable output buffer for displayPage, kept to avoid reallocating it on every call
+        std::string renderBuffer;
+
+        /** Appends the colored information card of a user to 'out'
+         **/
+        void appendDetails(std::string& out, const UserInfo& user) const {
+            const char* border = "\033[1;33m|\033[0m";
+            // Display the gathered information and results
+            out += "\n\033[1;33m=========================================\033[0m\n";
+            out += "\033[1;33m|            User: "; out += nameOf(user); out += "\033[0m\n";
+            out += "\033[1;33m=========================================\033[0m\n";
+            out += border; out += "\033[1;36m  Gender:\033[0m               "; out += user.gender; out += "\n";
+            out += border; out += "\033[1;36m  Age:\033[0m                  "; appendNumber(out, user.age); out += " years\n";
+            out += border; out += "\033[1;36m  Weight:\033[0m               "; appendNumber(out, user.weight, 6); out += " kg\n";
+            out += border; out += "\033[1;36m  Waist:\033[0m                "; appendNumber(out, user.waist, 6); out += " cm\n";
+            out += border; out += "\033[1;36m  Neck:\033[0m                 "; appendNumber(out, user.neck, 6); out += " cm\n";
+            out += border; out += "\033[1;36m  Height:\033[0m               "; appendNumber(out, user.height, 6); out += " cm\n";
+            // Display hip measurement if the user is female
+            if (user.gender == "female") {
+                out += border; out += "\033[1;36m  Hips:\033[0m              "; appendNumber(out, user.hip, 6); out += " cm\n";
+            }
+            out += border; out += "\033[1;36m  Lifestyle:\033[0m            "; out += user.lifestyle; out += "\n";
+            out += border; out += "\n";
+            out += border; out += "\033[1;34m  Body Fat Percentage:\033[0m  "; appendNumber(out, user.bfp.first); out += "%, "; out += user.bfp.second; out += "\n";
+            out += border; out += "\033[1;34m  Daily Calorie Intake:\033[0m "; appendNumber(out, user.calories, 6); out += " calories\n";
+            out += border; out += "\n";
+            out += border; out += "\033[1;35m  Carbohydrates:\033[0m        "; appendNumber(out, user.carbs, 6); out += " grams\n";
+            out += border; out += "\033[1;35m  Protein:\033[0m              "; appendNumber(out, user.protein, 6); out += " grams\n";
+            out += border; out += "\033[1;35m  Fat:\033[0m                  "; appendNumber(out, user.fat, 6); out += " grams\n";
+            out += "\033[1;33m=========================================\033[0m\n";
+        }
+
+        /** Appends one user as a plain tab-separated table row to 'out'
+         **/
+        void appendTableRow(std::string& out, const UserInfo& user) const {
+            out += nameOf(user); out += '\t';
+            out += user.gender; out += '\t';
+            appendNumber(out, user.age); out += '\t';
+            appendNumber(out, user.weight, 6); out += '\t';
+            appendNumber(out, user.waist, 6); out += '\t';
+            appendNumber(out, user.neck, 6); out += '\t';
+            appendNumber(out, user.height, 6); out += '\t';
+            appendNumber(out, user.hip, 6); out += '\t';
+            out += user.lifestyle; out += '\t';
+            appendNumber(out, user.bfp.first); out += '\t';
+            out += user.bfp.second; out += '\t';
+            appendNumber(out, user.calories, 6); out += '\t';
+            appendNumber(out, user.carbs, 6); out += '\t';
+            appendNumber(out, user.protein, 6); out += '\t';
+            appendNumber(out, user.fat, 6); out += '\n';
+        }
+};
+
+
+/** Out-of-core storage of a user population as fixed-size chunk files of columns
+ * Each chunk is a columnar export (see UserInfoManager::writeColumnar) named chunk-<number>.hacol in one directory
+ * Chunks are memory-mapped on demand and unmapped least-recently-used first to stay within 'memoryBudget' bytes,
+ * which also covers the users decoded from the chunk being processed (estimated at UserInfoManager::bytesPerUser each)
+ * A chunk that does not fit the budget on its own is still loaded, so the real bound is the larger of the budget and one chunk
+ * Every operation runs chunk-at-a-time, so the population can be far larger than memory
+ **/
+class ChunkedUserStore
+{
+    private:
+        struct Mapping {
+            const char* data;
+            size_t size;
+            std::list<size_t>::iterator recent;
+        };
+
+        std::string directory;
+        size_t memoryBudget;
+        size_t chunks=0;
+        size_t mappedBytes=0;
+        size_t decodedBytes=0;
+        std::unordered_map<size_t, Mapping> mapped;
+        std::list<size_t> recentlyUsed;
+
+        static std::string chunkPath(const std::string& directory, size_t chunk) {
+            char name[48];
+            std::snprintf(name, sizeof(name), "/chunk-%06zu.hacol", chunk);
+            return directory + name;
+        }
+
+        void unmap(size_t chunk) {
+            auto entry = mapped.find(chunk);
+            if (entry == mapped.end()) return;
+            ::munmap(const_cast<char*>(entry->second.data), entry->second.size);
+            mappedBytes -= entry->second.size;
+            recentlyUsed.erase(entry->second.recent);
+            mapped.erase(entry);
+        }
+
+        // Unmaps least recently used chunks until 'extra' more bytes fit in the budget (or nothing is left to unmap)
+        void makeRoom(size_t extra) {
+            while (!recentlyUsed.empty() && mappedBytes + decodedBytes + extra > memoryBudget) {
+                unmap(recentlyUsed.back());
+            }
+        }
+
+        /** Maps a chunk file if it is not mapped yet, and marks it as most recently used
+         * Throws a runtime error if the chunk file cannot be opened or mapped
+         **/
+        const Mapping& map(size_t chunk) {
+            auto entry = mapped.find(chunk);
+            if (entry != mapped.end()) {
+                recentlyUsed.splice(recentlyUsed.begin(), recentlyUsed, entry->second.recent);
+                return entry->second;
+            }
+            std::string path = chunkPath(directory, chunk);
+            int fd = ::open(path.c_str(), O_RDONLY);
+            struct stat info;
+            if (fd < 0 || ::fstat(fd, &info) != 0) {
+                if (fd >= 0) ::close(fd);
+                throw std::runtime_error("Could not open chunk " + path);
+            }
+            size_t size = info.st_size;
+            makeRoom(size);
+            void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if (data == MAP_FAILED) {
+                throw std::runtime_error("Could not map chunk " + path);
+            }
+            recentlyUsed.push_front(chunk);
+            mappedBytes += size;
+            return mapped.emplace(chunk, Mapping{static_cast<const char*>(data), size, recentlyUsed.begin()}).first->second;
+        }
+
+        // Decodes one chunk into 'users' in place of the previous one, keeping the decoded users within the memory budget
+        void load(size_t chunk, UserInfoManager& users) {
+            const Mapping& mapping = map(chunk);
+            users.loadColumnar(mapping.data, mapping.size, chunkPath(directory, chunk));
+            decodedBytes = users.userCount() * UserInfoManager::bytesPerUser;
+            makeRoom(0);
+        }
+
+    public:
+        /** Constructor
+         * Opens the chunks in an existing directory written by build
+         * Throws a runtime error if the directory holds no chunks
+         **/
+        ChunkedUserStore(const std::string& directory, size_t memoryBudget=size_t(1) << 30) : directory(directory), memoryBudget(memoryBudget) {
+            while (std::ifstream(chunkPath(directory, chunks))) chunks++;
+            if (chunks == 0) {
+                throw std::runtime_error("Directory " + directory + " does not hold any user chunks.");
+            }
+        }
+
+        /** Destructor
+         * Unmaps all mapped chunks
+         **/
+        ~ChunkedUserStore() {
+            while (!recentlyUsed.empty()) unmap(recentlyUsed.back());
+        }
+
+        ChunkedUserStore(const ChunkedUserStore&) = delete;
+        ChunkedUserStore& operator=(const ChunkedUserStore&) = delete;
+
+        /** Splits a .csv file into chunk files of 'rowsPerChunk' users in 'directory', replacing any chunks already there
+         * Only one chunk of users is held in memory at a time
+         * Returns the number of chunks written
+         **/
+        static size_t build(const std::string& csvFile, const std::string& directory, size_t rowsPerChunk=size_t(1) << 20) {
+            std::filesystem::create_directories(directory);
+            for (size_t chunk = 0; std::filesystem::remove(chunkPath(directory, chunk)); ++chunk) {}
+            size_t chunks = 0;
+            UserInfoManager users;
+            users.readFromFileInChunks(csvFile, std::max<size_t>(1, rowsPerChunk), [&](UserInfoManager& chunk) {
+                chunk.writeColumnar(chunkPath(directory, chunks++), rowsPerChunk);
+            });
+            return chunks;
+        }
+
+        size_t chunkCount() const { return chunks; }
+
+        /** Calls fn(users) with the users of each chunk in turn
+         * Changes fn makes are not written back (see updateChunks)
+         **/
+        template <typename Fn>
+        void forEachChunk(Fn fn) {
+            UserInfoManager users;
+            for (size_t chunk = 0; chunk < chunks; ++chunk) {
+                load(chunk, users);
+                fn(users);
+            }
+            decodedBytes = 0;
+        }
+
+        /** Calls fn(users) with the users of each chunk in turn and writes each chunk back afterwards
+         * Each chunk is rewritten through a temporary file that is synced into place (see replaceFile), so a crash leaves either the old or the new chunk
+         **/
+        template <typename Fn>
+        void updateChunks(Fn fn) {
+            UserInfoManager users;
+            for (size_t chunk = 0; chunk < chunks; ++chunk) {
+                load(chunk, users);
+                fn(users);
+                unmap(chunk);
+                std::string path = chunkPath(directory, chunk);
+                users.writeColumnar(path + ".tmp.hacol", std::max<size_t>(1, users.userCount()));
+                replaceFile(path + ".tmp.hacol", path);
+            }
+            decodedBytes = 0;
+        }
+
+        /** Gets the usernames of all users in the given bfp groups (see UserInfoManager::getBfpUsers), chunk by chunk
+         **/
+        std::vector<std::string> getBfpUsers(const std::vector<std::string>& bfpGroups, const std::string& gender="") {
+            std::vector<std::string> users;
+            forEachChunk([&](UserInfoManager& chunk) {
+                std::vector<std::string> chunkUsers = chunk.getBfpUsers(bfpGroups, gender);
+                users.insert(users.end(), chunkUsers.begin(), chunkUsers.end());
+            });
+            return users;
+        }
+
+        std::vector<std::string> healthyUsers(const std::string& gender="") { return getBfpUsers({"normal", "healthy weight"}, gender); }
+        std::vector<std::string> unhealthyUsers(const std::string& gender="") { return getBfpUsers({"high", "very high", "overweight", "obesity", "low", "underweight"}, gender); }
+
+        /** Aggregates all users grouped by the given keys (see UserInfoManager::groupBy), merging the groups of every chunk
+         **/
+        std::vector<UserInfoManager::GroupStats> groupBy(const std::vector<std::string>& keys) {
+            std::vector<UserInfoManager::GroupStats> merged;
+            forEachChunk([&](UserInfoManager& chunk) {
+                for (const UserInfoManager::GroupStats& group : chunk.groupBy(keys)) {
+                    auto same = std::find_if(merged.begin(), merged.end(), [&group](const UserInfoManager::GroupStats& other) {
+                        return other.ageBand == group.ageBand && other.gender == group.gender && other.lifestyle == group.lifestyle
+                            && other.group == group.group && other.method == group.method;
+                    });
+                    if (same == merged.end()) {
+                        merged.push_back(group);
+                        continue;
+                    }
+                    same->count += group.count;
+                    same->bfp.merge(group.bfp);
+                    same->calories.merge(group.calories);
+                    same->carbs.merge(group.carbs);
+                    same->protein.merge(group.protein);
+                    same->fat.merge(group.fat);
+                }
+            });
+            return merged;
+        }
+};
+
+
+class HealthAssistant {
+    protected:
+
+        /** A static instance of the UserInfoManager 'mymanager' to manage user information
+         * All HealthAssistant instances share the same UserInfoManager instance
+         * This means that all HealthAssistant instances share the same UserInfo vector
+         * Protected since derived classes also use the same UserInfo list
+         **/
+        static UserInfoManager mymanager;
+
+    public:
+
+        /** Daily calorie intake and macronutrient breakdown in grams
+         **/
+        struct Nutrition {
+            double calories;
+            double carbs;
+            double protein;
+            double fat;
         };
-        
-        /** A vector of UserInfo objects to store user information
-         * Each UserInfo object represents a user and their input information
-         * 'mylist' is a private member since only the UserInfoManager can understand the UserInfo type
-         * 'mylist' is specific to the UserInfoManager instance
-        */
-        std::vector<UserInfo> mylist;
-        
-        /** A template representing inputs for the validateInput function
-         * 'Typ' is the type of the attribute to update (string, int, or double)
-         * 'Constraint' is the type of the constraints (vector of string, pair of int, or pair of double)
-         **/ 
-        template <typename Typ, typename Constraint>
 
-        /** Validates a string, integer, or double input based on the given constraints, and updates the given attribute
-         * Private member since the UserInfoManager is responsible for collecting user inputs and updating user data
-         * Throws a runtime error if the input is invalid or outside the given limits
-         **/ 
-        void validateInput(const std::string& prompt, const std::string& error, Constraint constraints, Typ& attribute) {
-            Typ input;
-            std::cout << prompt;
-            std::cin >> input;
+        /** Splits a daily calorie intake into grams of each macronutrient
+         * Uses a 50% carbohydrate, 30% protein, 20% fat breakdown
+         **/
+        static constexpr Nutrition mealPrepFor(double calories) {
+            // Constants for macronutrient calorie values
+            const int carb_calories = 4;
+            const int protein_calories = 4;
+            const int fat_calories = 9;
 
-            // Check if the attribute to update is of type int or double
-            if constexpr (std::is_same<Typ, int>::value || std::is_same<Typ, double>::value) {
-                // Check if input is invalid or outside the given limits
-                if (!std::cin || input < constraints.first || input > constraints.second) {
-                    // Clear the input buffer and throw an error
-                    std::cin.clear();
-                    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-                    throw std::runtime_error(error);
+            // Constants for recommended macronutrient breakdown percentages
+            const double carb_percent = 0.5;
+            const double protein_percent = 0.3;
+            const double fat_percent = 0.2;
+
+            return { calories, (calories * carb_percent) / carb_calories, (calories * protein_percent) / protein_calories, (calories * fat_percent) / fat_calories };
+        }
+
+        /** Calculates the daily calorie intake and macronutrients for one (age bracket, gender, lifestyle) combination
+         * Age brackets are 30 and under, 31 to 50, and 51 and over; lifestyles are sedentary, moderate, and active
+         **/
+        static constexpr Nutrition nutritionFor(int ageBracket, bool male, int lifestyle) {
+            // Set base calorie intake then add additional calories based on age and gender
+            int calories = 1600;
+            if (ageBracket < 2) {
+                calories += (ageBracket == 1) ? 200 : 400;
+            }
+            calories += male ? 400 : 0;
+
+            // Add a scaled bonus per activity level above sedentary
+            int activityBonus = male ? 300 : 200;
+            calories += lifestyle * activityBonus;
+            return mealPrepFor(calories);
+        }
+
+        /** Precomputes nutritionFor for all 3 x 2 x 3 combinations, indexed by nutritionIndex
+         **/
+        static constexpr std::array<Nutrition, 18> makeNutritionTable() {
+            std::array<Nutrition, 18> table{};
+            for (int ageBracket = 0; ageBracket < 3; ++ageBracket) {
+                for (int male = 0; male < 2; ++male) {
+                    for (int lifestyle = 0; lifestyle < 3; ++lifestyle) {
+                        table[ageBracket * 6 + male * 3 + lifestyle] = nutritionFor(ageBracket, male, lifestyle);
+                    }
                 }
-                // Set the attribute to the input value
-                attribute = input;
+            }
+            return table;
+        }
 
-            // Check if the attribute to update is of type string
-            } else if constexpr (std::is_same<Typ, std::string>::value) {
-                // Convert to lowercase
-                std::transform(input.begin(), input.end(), input.begin(), ::tolower);
-                // Check if input is not the list of valid strings
-                if (std::find(constraints.begin(), constraints.end(), input) == constraints.end()) {
-                    // Throw an error
-                    throw std::runtime_error(error);
+        /** Lookup table of daily calories and macros keyed by (age bracket, gender, lifestyle)
+         **/
+        static const std::array<Nutrition, 18> nutritionTable;
+
+        /** Returns the nutritionTable row for a user's age and category codes
+         * Unknown genders count as female and unknown lifestyles as active, like the original string comparisons
+         **/
+        static size_t nutritionIndex(int age, uint8_t genderCode, uint8_t lifestyleCode) {
+            size_t ageBracket = (age < 31) ? 0 : (age < 51) ? 1 : 2;
+            size_t male = (genderCode == 1) ? 1 : 0;
+            size_t lifestyle = std::min<size_t>(lifestyleCode, 2);
+            return ageBracket * 6 + male * 3 + lifestyle;
+        }
+
+        /** Constructor
+         * Protected to prevent instantiation of the HealthAssistant class directly
+         * The HealthAssistant class on its own has no way to calculate bfp
+         * A new instance starts with no users and no open journal
+         **/
+        HealthAssistant() {mymanager.closeJournal(); mymanager.clearUsers();}
+
+        /** Destructor
+         * Virtual so a derived method can be deleted through a HealthAssistant pointer
+         **/
+        virtual ~HealthAssistant() {}
+
+        /** Virtual method to calculate body fat percentage
+         * Derived classes must implement this method to calculate body fat percentage
+         * The BFP calculation method is specific to the derived class
+         **/
+        virtual void getBfp(std::string username) = 0;
+
+        /** Name of the method the derived class calculates body fat percentage with, e.g. "USNavy"
+         **/
+        virtual std::string methodName() const = 0;
+
+        /** Whether a .csv file holds every result the method calculates, so users with a matching fingerprint can keep their stored results
+         * Methods that calculate results the file has no column for override this to always calculate every user
+         **/
+        virtual bool resultsFitFile() const { return true; }
+
+        /** Identifies the method results are calculated with in the users' fingerprints
+         * The bfp thresholds are left out: a stored bfp is re-bucketed into new groups without recalculating it (see reclassify),
+         * so neither a reclassify nor a load under other thresholds makes the users stale
+         **/
+        uint64_t fingerprintSalt() const {
+            uint64_t salt = 0;
+            for (char c : methodName()) salt = fingerprintMix(salt, static_cast<uint64_t>(static_cast<unsigned char>(c)));
+            return salt;
+        }
+
+        /** Calculates and updates the body fat percentage of every user in 'users' (the shared users by default)
+         * Derived classes override this with a single pass over the users; this fallback looks each user up by name,
+         * so it can only calculate the shared users and throws a runtime error for any others
+         **/
+        virtual void getAllBfp(UserInfoManager& users=mymanager) {
+            LatencyTimer timer("getAllBfp");
+            if (&users != &mymanager) {
+                throw std::runtime_error("Method " + methodName() + " can only calculate the shared users.");
+            }
+            for (std::string username : mymanager.allUsers()) {
+                getBfp(username);
+            }
+        }
+
+        /** Calculates and updates the recommended daily calorie intake for a user based on age and lifestyle
+         **/
+        void getDailyCalories(std::string username){
+            LatencyTimer timer("getDailyCalories");
+            // Look up the calorie intake for the user's age bracket, gender and lifestyle
+            mymanager.updateUser(username, [](auto& user) {
+                user.calories = nutritionTable[nutritionIndex(user.age, user.genderCode, user.lifestyleCode)].calories;
+            });
+        }
+
+        /** Calculates and updates the macronutrient breakdown for a user based on their daily calorie intake
+         **/
+        void getMealPrep(std::string username){
+            LatencyTimer timer("getMealPrep");
+            mymanager.updateUser(username, [](auto& user) {
+                // If the user's daily calorie intake has not been calculated, throw an error
+                int calories = user.calories;
+                if (calories == 0) {
+                    throw std::runtime_error("A user's daily calorie intake must be calculated before their macronutrient breakdown.");
                 }
-                // Set the attribute to the input value
-                attribute = input;
 
-            // Throw an error if either the attribute type is unsupported
+                // Calculate grams for each macronutrient and set the user's macronutrient breakdown
+                Nutrition meal = mealPrepFor(calories);
+                user.carbs = meal.carbs;
+                user.protein = meal.protein;
+                user.fat = meal.fat;
+            });
+        }
+
+        /** Calculates the daily calorie intake and macronutrient breakdown of every user in 'users' (the shared users by default) in one pass
+         * Each user's results are gathered from nutritionTable without any string comparisons or divisions
+         **/
+        void getAllNutrition(UserInfoManager& users=mymanager){
+            LatencyTimer timer("getAllNutrition");
+            users.forEachUser([](auto& user) {
+                const Nutrition& nutrition = nutritionTable[nutritionIndex(user.age, user.genderCode, user.lifestyleCode)];
+                user.calories = nutrition.calories;
+                user.carbs = nutrition.carbs;
+                user.protein = nutrition.protein;
+                user.fat = nutrition.fat;
+            });
+        }
+
+        /** Overwrites the static UserInfo vector 'mylist' with user information from a .csv file, then updates all users' calculated information
+         * Calculates body fat percentage, daily calorie intake, and macronutrient breakdown for each user
+         * Files written after a calculation carry a fingerprint of each user's inputs; a user whose inputs and method still match
+         * keeps its stored results, re-bucketed into the current groups, so only changed users are calculated again
+         * (unless the method's results do not fit the file)
+         * If 'filter' is given, only matching users are kept; a group condition tests the recalculated group, not the stored one
+         **/
+        void massLoadAndCompute(std::string filename, const ScanFilter& filter=ScanFilter()){
+            LatencyTimer timer("massLoadAndCompute");
+            if (filter.groups.empty()) {
+                loadAndCompute(filename, filter);
+                return;
+            }
+            // A stored group may be stale, so the other conditions are tested while reading and the group once calculated
+            ScanFilter inputs = filter;
+            inputs.groups.clear();
+            loadAndCompute(filename, inputs);
+            mymanager.retainUsers([&](const auto& user) { return filter.matches(user.gender, user.age, user.lifestyle, user.bfp.second); });
+        }
+
+        /** Does the work of massLoadAndCompute for a filter on input columns only
+         **/
+        void loadAndCompute(const std::string& filename, const ScanFilter& filter) {
+            uint64_t salt = fingerprintSalt();
+            if (resultsFitFile() && UserInfoManager::hasFingerprints(filename)) {
+                // The file says which inputs its stored results were calculated from, so keep them and calculate only the stale users
+                mymanager.readFromFile(filename, {}, filter);
+                std::vector<size_t> stale = mymanager.staleUsers(salt);
+                if (stale.size() < mymanager.userCount()) {
+                    // The file may have been calculated under other thresholds, so the kept bfps are re-bucketed into the current groups
+                    mymanager.reclassify(BfpThresholds::current());
+                    if (stale.empty()) return;
+                    // Calculate the stale users in a population of their own, like a computeFile batch, and take their results back
+                    UserInfoManager batch = mymanager.copyUsers(stale);
+                    getAllBfp(batch);
+                    getAllNutrition(batch);
+                    batch.stampFingerprints(salt);
+                    mymanager.mergeResults(batch, stale);
+                    return;
+                }
             } else {
-                throw std::runtime_error("Input type" + std::string(typeid(Typ).name()) + " is not supported.");
+                // Read user information from the file to populate the static UserInfo vector, keeping only the users matching 'filter'
+                // The stored results are recalculated below, so their columns are not converted
+                mymanager.readFromFile(filename, UserInfoManager::inputColumns, filter);
             }
+            // Update each user's body fat percentage
+            getAllBfp();
+            // Fill every user's daily calorie intake and macronutrient breakdown from the lookup table
+            getAllNutrition();
+            mymanager.stampFingerprints(salt);
         }
 
-        /** Finds the UserInfo with the given name in the private UserInfo vector 'mylist'
-         * The UserInfo vector searched is specific to the UserInfoManager instance
-         * Private member since only a UserInfoManager understands the UserInfo type (returns UserInfo&)
-         * Throws a runtime error if the user is not found
-         **/ 
-        UserInfo& findUser(const std::string& username) {
-            // Find user according to username
-            auto user = std::find_if(mylist.begin(), mylist.end(), [&username](const UserInfo& user) {
-                return user.name == username;
+        /** Per-stage counters of a computeFile run
+         * A stage whose input queue runs nearly full is slower than the stages feeding it; one whose queue runs empty is starved
+         **/
+        struct PipelineMetrics {
+            struct Stage {
+                std::string name;
+                size_t batches;
+                double busySeconds;
+            };
+            std::vector<Stage> stages;
+            SpscRing<UserInfoManager>::Metrics computeQueue;
+            SpscRing<UserInfoManager>::Metrics writeQueue;
+        };
+
+        /** Reads users from 'inFile', computes their calculated information, and writes them to 'outFile' in one pass
+         * Parsing, computing and writing run on their own threads and hand batches of 'batchSize' users
+         * to each other through bounded lock-free queues, so reading and writing overlap the calculations
+         * Only a few batches are held in memory at a time; each batch is calculated in place, so the shared users are not touched
+         * Throws the first error of any stage, e.g. a runtime error if a file cannot be opened or has the wrong extension
+         **/
+        PipelineMetrics computeFile(const std::string& inFile, const std::string& outFile, size_t batchSize=4096, size_t queueSize=8) {
+            LatencyTimer timer("computeFile");
+            std::string extension = ".csv";
+            if (outFile.size() <= extension.size() || outFile.substr(outFile.size() - extension.size()) != extension) {
+                throw std::runtime_error("File " + outFile + " is not a .csv file. The Health Assistant can only write to .csv files.");
+            }
+            std::ofstream file(outFile);
+            if (!file) {
+                throw std::runtime_error("Could not open file " + outFile);
+            }
+            file << "name,gender,age,weight,waist,neck,height,hip,bfp,group,calories,carbs,protein,fat,lifestyle,fingerprint\n";
+
+            SpscRing<UserInfoManager> toCompute(queueSize), toWrite(queueSize);
+            PipelineMetrics metrics;
+            uint64_t salt = fingerprintSalt();
+            metrics.stages = { { "parse", 0, 0.0 }, { "compute", 0, 0.0 }, { "write", 0, 0.0 } };
+            std::exception_ptr errors[3];
+            std::atomic<bool> failed{false};
+            auto seconds = [](std::chrono::steady_clock::time_point start) {
+                return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            };
+
+            // Parse: read batches of users and pass them on, stopping early if a later stage failed
+            std::thread parser([&] {
+                PipelineMetrics::Stage& stage = metrics.stages[0];
+                AllocationPhase allocations("parse stage");
+                try {
+                    UserInfoManager users;
+                    auto start = std::chrono::steady_clock::now();
+                    users.readFromFileInChunks(inFile, std::max<size_t>(1, batchSize), [&](UserInfoManager& batch) {
+                        if (failed.load(std::memory_order_relaxed)) throw std::runtime_error("Pipeline stopped");
+                        stage.busySeconds += seconds(start);
+                        toCompute.push(std::move(batch));
+                        stage.batches++;
+                        start = std::chrono::steady_clock::now();
+                    }, UserInfoManager::inputColumns);
+                } catch (...) {
+                    errors[0] = std::current_exception();
+                    failed = true;
+                }
+                toCompute.close();
             });
-            // Throw an error if user not found
-            if (user == mylist.end()) {
-                throw std::runtime_error("User with name " + username + " does not exist.");
+
+            // Compute: calculate each batch like massLoadAndCompute
+            std::thread computer([&] {
+                PipelineMetrics::Stage& stage = metrics.stages[1];
+                AllocationPhase allocations("compute stage");
+                UserInfoManager batch;
+                while (toCompute.pop(batch)) {
+                    if (failed.load(std::memory_order_relaxed)) continue;
+                    TraceSpan span("compute batch", "pipeline");
+                    auto start = std::chrono::steady_clock::now();
+                    try {
+                        getAllBfp(batch);
+                        getAllNutrition(batch);
+                        batch.stampFingerprints(salt);
+                    } catch (...) {
+                        errors[1] = std::current_exception();
+                        failed = true;
+                        continue;
+                    }
+                    stage.busySeconds += seconds(start);
+                    toWrite.push(std::move(batch));
+                    stage.batches++;
+                }
+                toWrite.close();
+            });
+
+            // Write: append each batch's rows in order on this thread
+            PipelineMetrics::Stage& stage = metrics.stages[2];
+            AllocationPhase allocations("write stage");
+            UserInfoManager batch;
+            while (toWrite.pop(batch)) {
+                if (failed.load(std::memory_order_relaxed)) continue;
+                TraceSpan span("write batch", "pipeline");
+                auto start = std::chrono::steady_clock::now();
+                batch.writeRows(file);
+                if (!file) {
+                    errors[2] = std::make_exception_ptr(std::runtime_error("Could not write file " + outFile));
+                    failed = true;
+                }
+                stage.busySeconds += seconds(start);
+                stage.batches++;
             }
-            // Return user if found
-            return *user;
+            parser.join();
+            computer.join();
+            for (std::exception_ptr error : errors) {
+                if (error) std::rethrow_exception(error);
+            }
+            metrics.computeQueue = toCompute.metrics();
+            metrics.writeQueue = toWrite.metrics();
+            return metrics;
         }
 
-    public:
-        /** Constructor
-         * Initializes the empty vector of UserInfo objects 'mylist'
-         * The vector is specific to the UserInfoManager instance
+        /** Adds a new user from a .csv row in the column order of UserInfoManager::inputColumns and calculates their information
+         * Throws a runtime error if the row is invalid or the user already exists
          **/
-        UserInfoManager() : mylist() {}
+        void addUser(const std::string& row){
+            LatencyTimer timer("addUser");
+            mymanager.addUserRow(row);
+            std::string username = row.substr(0, row.find(','));
+            getBfp(username);
+            getDailyCalories(username);
+            getMealPrep(username);
+            mymanager.stampFingerprint(username, fingerprintSalt());
+        }
 
-        /** Destructor
-         * Clears the vector of UserInfo objects 'mylist'
-         * The vector is specific to the UserInfoManager instance
+        /** Moves all loaded users out of the shared UserInfoManager, leaving it empty
+         * Lets callers keep one population while loading another, e.g. to join them
          **/
-        ~UserInfoManager() { mylist.clear(); }
+        UserInfoManager releaseUsers() {
+            return mymanager.releaseUsers();
+        }
 
-        // Method to clear mylist of all users
-        void clearUsers() { mylist.clear(); }
+        /** Updates all users' calculated information in an out-of-core store, one chunk at a time
+         * Each chunk is computed and fingerprinted like massLoadAndCompute, and written back
+         **/
+        void massLoadAndCompute(ChunkedUserStore& store){
+            LatencyTimer timer("massLoadAndCompute");
+            uint64_t salt = fingerprintSalt();
+            store.updateChunks([this, salt](UserInfoManager& chunk) {
+                getAllBfp(chunk);
+                getAllNutrition(chunk);
+                chunk.stampFingerprints(salt);
+            });
+        }
 
-        /** Adds a new user to the 'mylist' vector
-         * Prompts the user for input and validates the input
-         * Throws a runtime error if the input is invalid or outside the given limits
+        /** Wrappers for the public UserInfoManager methods
          **/
-        void addUserInfo() {
-            UserInfo newUser;
+        void getUserDetail() { mymanager.addUserInfo(); }
+        void display(std::string username){ mymanager.display(username); }; 
+        void displayPage(size_t offset, size_t limit, std::string format="card"){ mymanager.displayPage(offset, limit, format); };
+        void serialize(std::string filename, int precision=6){
+            // Pick the export format from the file extension
+            if (filename.size() > 6 && filename.substr(filename.size() - 6) == ".jsonl") mymanager.writeJsonLines(filename);
+            else if (filename.size() > 6 && filename.substr(filename.size() - 6) == ".hacol") mymanager.writeColumnar(filename);
+            else mymanager.writeToFile(filename, precision);
+        }; 
+        void readFromFile(std::string filename, std::vector<std::string> columns={}, ScanFilter filter=ScanFilter()){ mymanager.readFromFile(filename, columns, filter);}; 
+        void deleteUser(std::string username){ mymanager.deleteUser(username);}; 
+        std::string userRow(std::string username){ return mymanager.userRow(username); };
+        void userRows(const std::vector<std::string_view>& usernames, std::vector<std::string>& rows, std::vector<bool>& found){ mymanager.userRows(usernames, rows, found); };
+        std::vector<std::string> filterUsers(const ScanFilter& filter){ return mymanager.filterUsers(filter); };
+        template <typename Pred>
+        size_t deleteWhere(Pred pred){ return mymanager.deleteWhere(pred); };
+        void openJournal(std::string snapshot, std::string journalFile, size_t groupSize=64, size_t compactEvery=0){ mymanager.openJournal(snapshot, journalFile, groupSize, compactEvery); };
+        void commitJournal(){ mymanager.commitJournal(); };
+        void compactJournal(){ mymanager.compactJournal(); };
+        void closeJournal(){ mymanager.closeJournal(); };
+        std::vector<std::string> healthyUsers(std::string gender){ return mymanager.healthyUsers(gender); };
+        std::vector<std::string> unhealthyUsers(std::string gender){ return mymanager.unhealthyUsers(gender); };
+        std::vector<std::string> allUsers(std::string gender){ return mymanager.allUsers(gender); };
+        std::vector<UserInfoManager::GroupStats> groupBy(std::vector<std::string> keys){ return mymanager.groupBy(keys); };
+        UserInfoManager::MethodComparison compareMethods(){ return mymanager.compareMethods(); };
+        size_t reclassify(){ return mymanager.reclassify(BfpThresholds::current()); };
+        const UserInfoManager::LiveStats& liveStats(){ return mymanager.liveStats(); };
+        void createView(std::string name, const ScanFilter& filter){ mymanager.createView(name, filter); };
+        void dropView(std::string name){ mymanager.dropView(name); };
+        std::vector<std::string> viewUsers(std::string name){ return mymanager.viewUsers(name); };
+        std::vector<std::string> viewNames(){ return mymanager.viewNames(); };
+        UserInfoManager::JoinResult joinByName(const UserInfoManager& other){ return mymanager.joinByName(other); };
+        std::vector<std::pair<std::string, double>> topUsers(std::string field, size_t k, bool highest=true){ return mymanager.topUsers(field, k, highest); };
+        std::vector<double> percentiles(std::string field, std::vector<double> ps, std::string gender="", std::string ageBand=""){ return mymanager.percentiles(field, ps, gender, ageBand); };
+        QuantileSketch sketch(std::string field, std::string gender="", std::string ageBand="", size_t accuracy=400){ return mymanager.sketch(field, gender, ageBand, accuracy); };
+};
 
-            // Prompt for name input
-            std::string input;
-            std::cout << "\nPlease enter your name: ";
+class USNavyMethod : public HealthAssistant {
+    public:
 
-            // Validate name input (only letters)
-            std::cin >> input;
-            for (char c : input) {
-                if (!std::isalpha(c)) {
-                    throw std::runtime_error("Invalid name. Please enter a name containing only letters.");
-                }
-            }
-            newUser.name = input;
+        std::string methodName() const { return "USNavy"; }
 
-            // Prompt for and validate gender
-            std::vector<std::string> validGenders = { "female", "male" };
-            validateInput(
-                "Please specify your gender as either male or female: ", 
-                "Invalid gender. Gender must be either male or female.", 
-                validGenders, newUser.gender
-            );
+    private:
 
-            // Prompt for and validate age
-            std::pair<int, int> ageRange = { 19, 79 };
-            validateInput(
-                "Enter your age: ", 
-                "Invalid age. Age must be between 19 and 79.", 
-                ageRange, newUser.age
-            );
+        /** Method to get the body fat percentage group based on the user's age and gender
+         *  Returns a string representing the group the user falls into, using the current thresholds (see BfpThresholds)
+         **/
+        static const std::string& getBfpGroup(double bfp, int age, const std::string& gender) {
+            return BfpThresholds::current().usNavyGroup(bfp, age, gender);
+        }
 
-            // create a vector of pairs to simplify the measurement input validation process
-            std::vector<std::pair<std::string, double*>> attributes = {
-                {"Enter your body weight in kilograms: ", &newUser.weight},
-                {"Enter your waist measurement in centimeters: ", &newUser.waist},
-                {"Enter your neck measurement in centimeters: ", &newUser.neck},
-                {"Enter your height measurement in centimeters: ", &newUser.height},
-                {"Enter your hip measurement in centimeters: ", &newUser.hip}
-            };
+        // Calculates and stores the bfp and group of one user
+        template <typename User>
+        static void evaluate(User& user) {
+            double bfp = bfpValue(user.gender, user.waist, user.neck, user.hip, user.height);
+            user.exactBfp = bfp;
+            user.roundedBfp = false;
+            user.bfp = {bfp, BfpThresholds::current().usNavyGroup(bfp, user.age, user.genderCode)};
+        }
 
-            // Prompt for and validate body measurements
-            std::pair<double, double> measurementRange = { 0, std::numeric_limits<double>::max() };
-            for (auto& attribute : attributes) {
-                // Skip hip measurement if the user is a male
-                if ((attribute.second == &newUser.hip) && (newUser.gender == "male")){
-                    continue;
-                };
-                validateInput(
-                    attribute.first, 
-                    "Invalid measurement. Measurement must be greater than 0.0.", 
-                    measurementRange, *attribute.second
-                );
-            };  
+    public:
 
-            // Prompt for and validate lifestyle
-            std::vector<std::string> validLifestyles = { "sedentary", "moderate", "active" };
-            validateInput(
-                "Enter information about your current lifestyle (sedentary, moderate, or active): ", 
-                "Invalid lifestyle. Lifestyle must be either sedentary, moderate, or active.", 
-                validLifestyles, newUser.lifestyle
-            );
+        /** Calculates the unrounded body fat percentage for one set of measurements using the US Navy method
+         **/
+        static double bfpValue(const std::string& gender, double waist, double neck, double hip, double height) {
+            if (gender == "male") {
+                return 495 / (1.0324 - 0.19077 * log10(waist - neck) + 0.15456 * log10(height)) - 450;
+            }
+            return 495 / (1.29579 - 0.35004 * log10(waist + hip - neck) + 0.22100 * log10(height)) - 450;
+        }
 
-            // Print success message and add user to 'mylist'
-            std::cout << "User " << newUser.name << " has been added successfully.\n" << std::endl;
-            std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-        
-            mylist.push_back(newUser);
+        /** Calculates the body fat percentage and group for one set of measurements using the US Navy method
+         * Public and static so other evaluators can reuse the formula without a USNavyMethod instance
+         **/
+        static std::pair<int, std::string> calculateBfp(const std::string& gender, int age, double waist, double neck, double hip, double height) {
+            double bfp = bfpValue(gender, waist, neck, hip, height);
+            return {bfp, getBfpGroup(bfp, age, gender)};
         }
 
-        /** Deletes a user from the 'mylist' vector
-         * Removes the first user found with the given username in 'mylist'
-         * Throws a runtime error if the user is not found
+        /** Calculates and updates the body fat percentage of a user using the US Navy method
+         * Uses gender, age, waist, neck, hip, and height measurements to calculate body fat percentage
          **/
-        void deleteUser(const std::string& username) {
-            // Find user according to username
-            auto user = std::find_if(mylist.begin(), mylist.end(), [&username](const UserInfo& user) {
-                return user.name == username;
-            });
-            // Throw an error if user not found
-            if (user == mylist.end()) {
-                throw std::runtime_error("User with name " + username + " does not exist.");
-            }
-            // Remove user from list
-            mylist.erase(user);
+        void getBfp(std::string username) {
+            LatencyTimer timer("getBfp");
+            mymanager.updateUser(username, [](auto& user) { evaluate(user); });
         }
 
-        /** Filters usernames based on body fat percentage
-         * Returns a vector of strings containing all usernames that fall into the given bfp groups
+        /** Calculates and updates the body fat percentage of every user using the US Navy method in a single pass
          **/
-        std::vector<std::string> filterUsernames(const std::vector<std::string>& bfpGroups, const std::string& gender) {
-            std::vector<std::string> validUsernames;
-            // Iterate through all loaded users
-            for (const UserInfo &user : mylist) {
-                // Continue if the user's bfp group is in the list of valid groups
-                if (std::find(bfpGroups.begin(), bfpGroups.end(), user.bfp.second) != bfpGroups.end()) {
-                    if (gender == "") {
-                        // If the gender isn't specified, add the username to the list
-                        validUsernames.push_back(user.name);
-                    } else if (user.gender == gender) {
-                        // Else add the username to the list if the user's gender matches the input
-                        validUsernames.push_back(user.name);
-                    }
-                }
-            }
-            return validUsernames;
+        void getAllBfp(UserInfoManager& users=mymanager) {
+            LatencyTimer timer("getAllBfp");
+            users.forEachUser([](auto& user) { evaluate(user); });
         }
+};
 
-        /** Gets all usernames in this UserInfoManager instance's 'mylist' vector
-         * Returns a vector of strings containing all usernames
-         * Public member since other classes need to iterate through all users
+class BmiMethod : public HealthAssistant {
+    public:
+
+        std::string methodName() const { return "bmi"; }
+
+    private:
+    
+        /** Method to get the body fat percentage group based on the user's bfp
+         *  Returns a string representing the group the user falls into, using the current thresholds (see BfpThresholds)
          **/
-        std::vector<std::string> getBfpUsers(std::vector<std::string> bfpGroups, std::string gender="") {
-            std::vector<std::string> bfpUsers;
+        static const std::string& getBfpGroup(double bfp) {
+            return BfpThresholds::current().bmiGroup(bfp);
+        }
 
-            if (gender!="male"&&gender!="female"&&gender!="") {
-                throw std::invalid_argument("Gender must be either 'male' or 'female', or left blank.");
-            }
-            for (const UserInfo &user : mylist) {
-                if (user.bfp.second == "none" && bfpGroups.size()<8) {
-                    throw std::runtime_error("Body fat percentage has not been calculated for all users.");
-                } else if (std::find(bfpGroups.begin(), bfpGroups.end(), user.bfp.second) != bfpGroups.end() && (user.gender == gender || gender == "")) {
-                    bfpUsers.push_back(user.name);
-                }
-            }
-            return bfpUsers;
+        // Calculates and stores the bfp and group of one user
+        template <typename User>
+        static void evaluate(User& user) {
+            double bfp = bfpValue(user.weight, user.height);
+            user.exactBfp = bfp;
+            user.roundedBfp = false;
+            user.bfp = {bfp, getBfpGroup(bfp)};
         }
 
-        std::vector<std::string> healthyUsers(std::string gender="") {
-            return getBfpUsers({"normal", "healthy weight"}, gender);
+    public:
+
+        /** Calculates the unrounded body fat percentage for one set of measurements using the BMI method
+         **/
+        static double bfpValue(double weight, double height) {
+            return (weight / ((height/100) * (height/100)));
         }
 
-        std::vector<std::string> unhealthyUsers(std::string gender="") {
-            return getBfpUsers({"high", "very high", "overweight", "obesity", "low", "underweight"}, gender);
+        /** Calculates the body fat percentage and group for one set of measurements using the BMI method
+         * Public and static so other evaluators can reuse the formula without a BmiMethod instance
+         **/
+        static std::pair<int, std::string> calculateBfp(double weight, double height) {
+            double bfp = bfpValue(weight, height);
+            return {bfp, getBfpGroup(bfp)};
         }
 
-        std::vector<std::string> allUsers(std::string gender="") {
-            return getBfpUsers({"low", "normal", "high", "very high", "none", "underweight", "overweight", "healthy weight", "obesity"}, gender);
+        /** Calculates and updates the body fat percentage of a user using the BMI method
+         * Uses weight and height measurements to calculate body fat percentage
+        **/
+        void getBfp (std::string username) {
+            LatencyTimer timer("getBfp");
+            mymanager.updateUser(username, [](auto& user) { evaluate(user); });
         }
 
-        /** Getter methods to access user information
-         * Public member since other classes need to access user information
-         * Necessary since the 'mylist' vector and UserInfo struct are private to UserInfoManager
+        /** Calculates and updates the body fat percentage of every user using the BMI method in a single pass
          **/
-        int getAge(const std::string& username) { return findUser(username).age; }
-        std::string getGender(const std::string& username) { return findUser(username).gender; }
-        double getWeight(const std::string& username) { return findUser(username).weight; }
-        double getWaist(const std::string& username) { return findUser(username).waist; }
-        double getNeck(const std::string& username) { return findUser(username).neck; }
-        double getHeight(const std::string& username) { return findUser(username).height; }
-        double getHip(const std::string& username) { return findUser(username).hip; }
-        std::pair<int, std::string> getBfp(const std::string& username) { return findUser(username).bfp; }
-        double getCalories(const std::string& username) { return findUser(username).calories; }
-        std::string getLifestyle(const std::string& username) { return findUser(username).lifestyle; }
+        void getAllBfp(UserInfoManager& users=mymanager) {
+            LatencyTimer timer("getAllBfp");
+            users.forEachUser([](auto& user) { evaluate(user); });
+        }
+};
 
-        /** Setter methods to access user information
-         * Public member since other classes need to update user information
-         * Necessary since the 'mylist' vector and UserInfo struct are private to UserInfoManager
-         **/
-        void setBfp(const std::string& username, std::pair<int, std::string> bfp) { findUser(username).bfp = bfp; }
-        void setCalories(const std::string& username, double calories) { findUser(username).calories = calories; }
-        void setCarbs(const std::string& username, double carbs) { findUser(username).carbs = carbs; }
-        void setProtein(const std::string& username, double protein) { findUser(username).protein = protein; }
-        void setFat(const std::string& username, double fat) { findUser(username).fat = fat; }
-        void setLifestyle(const std::string& username, std::string lifestyle) { findUser(username).lifestyle = lifestyle; }
+class CombinedMethod : public HealthAssistant {
+    public:
 
+        std::string methodName() const { return "combined"; }
 
-        /** Reads user information from a .csv file and populates the 'mylist' vector
-         * Throws a runtime error if the file cannot be opened or is not a .csv file
+        // The per-method results have no column in a .csv file, so stored results cannot be kept
+        bool resultsFitFile() const { return false; }
+
+        /** Calculates both the US Navy and BMI body fat percentages of a user
+         * Each method's result is stored in its own column; the primary bfp column holds the US Navy result
          **/
-        void readFromFile(std::string filename) {
+        void getBfp(std::string username) {
+            LatencyTimer timer("getBfp");
+            mymanager.updateUser(username, [](auto& user) { evaluate(user); });
+        }
 
-            // Check if the file extension is .csv
-            std::string extension = ".csv";
-            if (filename.size() <= extension.size() || filename.substr(filename.size() - extension.size()) != extension) {
-                throw std::runtime_error("File " + filename + " is not a .csv file. The Health Assistant can only read .csv files.");
-            }
+        /** Calculates both methods for every user in a single pass over the loaded population
+         **/
+        void getAllBfp(UserInfoManager& users=mymanager) {
+            LatencyTimer timer("getAllBfp");
+            users.forEachUser([](auto& user) { evaluate(user); });
+        }
 
-            // Attempt to open the file
-            std::ifstream file(filename);
-            if (!file) {
-                throw std::runtime_error("Could not open file " + filename);
-            }
+    private:
 
-            mylist.clear();
+        // Fills the per-method columns and the primary bfp column of one user
+        template <typename User>
+        static void evaluate(User& user) {
+            double usNavy = USNavyMethod::bfpValue(user.gender, user.waist, user.neck, user.hip, user.height);
+            user.usNavyBfp = {usNavy, BfpThresholds::current().usNavyGroup(usNavy, user.age, user.genderCode)};
+            user.bmiBfp = BmiMethod::calculateBfp(user.weight, user.height);
+            user.bfp = user.usNavyBfp;
+            user.exactBfp = usNavy;
+            user.roundedBfp = false;
+        }
+};
 
-            // Skip the header line
-            std::string line;
-            std::getline(file, line);
+/** Serves queries on the users of a HealthAssistant over a Unix domain socket
+ * A frame is a 4-byte little-endian payload length followed by the payload; each request frame gets one reply frame, in order
+ * Requests are text: "lookup <name>", "filter [gender=<g>] [lifestyle=<l>] [group=<g>] [age=<min>-<max>]", "stats",
+ * "add <name>,<gender>,<age>,<weight>,<waist>,<neck>,<height>,<hip>,<lifestyle>", "delete <name>",
+ * "define <view> <filter conditions>", "view <view>" and "drop <view>" for named views (see UserInfoManager::createView),
+ * "reclassify <config file>" to load new bfp thresholds and re-bucket every user (see BfpThresholds), replying with the number changed,
+ * and "latency" for the per-operation latency report (see LatencyRecorder)
+ * Replies start with '+' followed by the result, or with '-' followed by an error message
+ * A "batch" frame holds several requests, one per line after a "batch" line; its reply is '+' followed by one
+ * length-prefixed reply per request, in order
+ * Clients may send many frames without waiting; the complete frames read at once are answered together in rounds,
+ * with runs of lookups resolved in one pass over the name index, and their replies sent with one write
+ * A client with more than 'maxBacklog' reply bytes unread is neither read from nor answered until it catches up
+ * One thread runs an epoll event loop over non-blocking sockets, so a slow client never holds up the others
+ * There is no authentication: any process that can connect to the socket may change users, and "reclassify" opens any path
+ * the server process can read and replaces the process-wide thresholds; restrict access with the permissions of the socket's directory
+ **/
+class QueryServer
+{
+    private:
+        struct Connection {
+            std::string in;
+            std::string out;
+            size_t sent=0;
+        };
 
-            // For each user in the file, read and populate the list
-            while (std::getline(file, line)) {
-                std::istringstream iss(line);
-                UserInfo newUser;
-                std::string field;
+        // Frames larger than this close the connection
+        static constexpr uint32_t maxFrame = 16 << 20;
+        // A connection is not read from or answered while more reply bytes than this wait to be sent
+        static constexpr size_t maxBacklog = maxFrame;
+        // Requests answered together before the reply backlog is checked again
+        static constexpr size_t roundSize = 256;
+        // Marks a frame holding a single request rather than a batch
+        static constexpr size_t plainFrame = std::numeric_limits<size_t>::max();
 
-                std::getline(iss, newUser.name, ',');
-                std::getline(iss, field, ','); newUser.gender = field;
-                std::getline(iss, field, ','); newUser.age = std::stoi(field);
-                std::getline(iss, field, ','); newUser.weight = std::stod(field);
-                std::getline(iss, field, ','); newUser.waist = std::stod(field);
-                std::getline(iss, field, ','); newUser.neck = std::stod(field);
-                std::getline(iss, field, ','); newUser.height = std::stod(field);
-                std::getline(iss, field, ','); newUser.hip = std::stod(field);
-                std::getline(iss, field, ','); newUser.bfp.first = std::stod(field);
-                std::getline(iss, field, ','); newUser.bfp.second = field;
-                std::getline(iss, field, ','); newUser.calories = std::stod(field);
-                std::getline(iss, field, ','); newUser.carbs = std::stod(field);
-                std::getline(iss, field, ','); newUser.protein = std::stod(field);
-                std::getline(iss, field, ','); newUser.fat = std::stod(field);
-                std::getline(iss, newUser.lifestyle, ',');
+        HealthAssistant& ha;
+        std::string path;
+        // Set once this server has bound the socket file at 'path', so only then is it removed again
+        bool ownsPath=false;
+        int listener=-1;
+        int poller=-1;
+        int wake=-1;
+        std::atomic<bool> stopping{false};
+        std::unordered_map<int, Connection> connections;
 
-                mylist.push_back(newUser);
-            }
+        // Scratch space reused by every read, so steady-state serving does not reallocate
+        std::vector<std::string_view> requests;
+        std::vector<size_t> frameSizes;
+        std::vector<std::string> replies;
+        std::vector<std::string_view> names;
+        std::vector<std::string> rows;
+        std::vector<bool> found;
+
+        // Closes all connections and sockets and removes the socket file
+        void release() {
+            for (auto& connection : connections) ::close(connection.first);
+            connections.clear();
+            if (listener >= 0) ::close(listener);
+            if (ownsPath) ::unlink(path.c_str());
+            if (poller >= 0) ::close(poller);
+            if (wake >= 0) ::close(wake);
+            listener = poller = wake = -1;
+            ownsPath = false;
         }
 
-        /** Overwrites the .csv file provided with the user information in the 'mylist' vector
-         *  Throws a runtime error if the file cannot be opened or is not a .csv file
+        /** Removes the socket file at 'address' if it was left behind by a server that is gone
+         * Throws a runtime error if the path is not a socket, or if a server still accepts connections on it
          **/
-        void writeToFile(std::string filename) {
-            // Check if the file extension is .csv
-            std::string extension = ".csv";
-            if (filename.size() <= extension.size() || filename.substr(filename.size() - extension.size()) != extension) {
-                throw std::runtime_error("File " + filename + " is not a .csv file. The Health Assistant can only write to .csv files.");
+        static void removeStaleSocket(const sockaddr_un& address) {
+            struct stat info;
+            if (::lstat(address.sun_path, &info) != 0) return;
+            std::string path = address.sun_path;
+            if (!S_ISSOCK(info.st_mode)) {
+                throw std::runtime_error("Could not serve on " + path + ": the path exists and is not a socket.");
             }
-
-            // Attempt to open the file
-            std::ofstream file(filename);
-            if (!file) {
-                throw std::runtime_error("Could not open file " + filename);
+            int probe = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (probe < 0) {
+                throw std::runtime_error("Could not serve on " + path + ": " + std::strerror(errno));
             }
+            int connected = ::connect(probe, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+            int error = errno;
+            ::close(probe);
+            // Only a refused connection shows that nothing listens on the socket any more
+            if (connected == 0 || error != ECONNREFUSED) {
+                throw std::runtime_error("Could not serve on " + path + ": another server is listening there.");
+            }
+            ::unlink(address.sun_path);
+        }
+
+        void closeConnection(int fd) {
+            ::epoll_ctl(poller, EPOLL_CTL_DEL, fd, nullptr);
+            ::close(fd);
+            connections.erase(fd);
+        }
 
-            // Write the header line
-            file << "name,gender,age,weight,waist,neck,height,hip,bfp,group,calories,carbs,protein,fat,lifestyle\n";
+        void watch(int fd, uint32_t events, int operation) {
+            epoll_event event{};
+            event.events = events;
+            event.data.fd = fd;
+            if (::epoll_ctl(poller, operation, fd, &event) != 0) {
+                throw std::runtime_error(std::string("Could not watch socket: ") + std::strerror(errno));
+            }
+        }
 
-            // Write each user's information to the file
-            for (const auto& user : mylist) {
-                file << user.name << "," << user.gender << "," << user.age << "," << user.weight << "," 
-                     << user.waist << "," << user.neck << "," << user.height << "," << user.hip << "," 
-                     << user.bfp.first << "," << user.bfp.second << "," << user.calories << ","
-                     << user.carbs << "," << user.protein << "," << user.fat << ","  << user.lifestyle << "\n";
+        // Accepts every pending connection
+        void acceptAll() {
+            while (true) {
+                int fd = ::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (fd < 0) return;
+                connections[fd];
+                watch(fd, EPOLLIN, EPOLL_CTL_ADD);
             }
         }
 
-        /** Displays user information for all users or a specific user
-         * Throws a runtime error if the user is not found
+        /** Writes as much pending output as the socket takes, then waits for writability only if output is left
+         * Returns false if the connection failed and was closed
          **/
-        void display(std::string username) {
-            if (username == "all") {
-                std::cout << "\nDisplaying information for all users...\n";
-                for (const auto& user : mylist) {
-                    displayDetails(user);
+        bool flush(int fd, Connection& connection) {
+            while (connection.sent < connection.out.size()) {
+                ssize_t written = ::send(fd, connection.out.data() + connection.sent, connection.out.size() - connection.sent, MSG_NOSIGNAL);
+                if (written < 0) {
+                    if (errno == EINTR) continue;
+                    if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+                    closeConnection(fd);
+                    return false;
                 }
-            } else {
-                std::cout << "\nDisplaying information for user " << username << "...\n";
-                displayDetails(findUser(username));
+                connection.sent += written;
             }
-            std::cout << "\nDone.\n\n";
+            bool pending = connection.sent < connection.out.size();
+            if (!pending) {
+                connection.out.clear();
+                connection.sent = 0;
+            }
+            // A client that does not read its replies is not read from either, so its buffers stay bounded
+            watch(fd, !pending ? EPOLLIN : backlogged(connection) ? EPOLLOUT : (EPOLLIN | EPOLLOUT), EPOLL_CTL_MOD);
+            return true;
         }
 
-        /** Displays user information for a specific user
+        static bool backlogged(const Connection& connection) {
+            return connection.out.size() - connection.sent > maxBacklog;
+        }
+
+        /** Reads what is available, then answers the complete request frames (see answerFrames)
+         * At most one largest frame is read ahead; the rest stays in the socket and is read once these frames are answered
          **/
-        void displayDetails(const UserInfo& user) {
-            int lineLength = 42;
-     
-            // Display the gathered information and results
-            std::cout << "\n\033[1;33m=========================================\033[0m\n";
-            std::cout << "\033[1;33m|            User: " << user.name << "\033[0m\n";
-            std::cout << "\033[1;33m=========================================\033[0m\n";
-            std::cout << "\033[1;33m|\033[0m" << "\033[1;36m  Gender:\033[0m               " << user.gender << "\n";
-            std::cout << "\033[1;33m|\033[0m" << "\033[1;36m  Age:\033[0m                  " << user.age << " years\n";
-            std::cout << "\033[1;33m|\033[0m" << "\033[1;36m  Weight:\033[0m               " << user.weight << " kg\n";
-            std::cout << "\033[1;33m|\033[0m" << "\033[1;36m  Waist:\033[0m                " << user.waist << " cm\n";
-            std::cout << "\033[1;33m|\033[0m" << "\033[1;36m  Neck:\033[0m                 " << user.neck << " cm\n";
-            std::cout << "\033[1;33m|\033[0m" << "\033[1;36m  Height:\033[0m               " << user.height << " cm\n";
-            // Display hip measurement if the user is female
-            if (user.gender == "female") {
-                std::cout << "\033[1;33m|\033[0m" << "\033[1;36m  Hips:\033[0m              " << user.hip << " cm\n";
-            }
-            std::cout << "\033[1;33m|\033[0m" << "\033[1;36m  Lifestyle:\033[0m            " << user.lifestyle << "\n";
-            std::cout << "\033[1;33m|\033[0m\n";
-            std::cout << "\033[1;33m|\033[0m" << "\033[1;34m  Body Fat Percentage:\033[0m  " << user.bfp.first << "%, " << user.bfp.second << "\n";
-            std::cout << "\033[1;33m|\033[0m" << "\033[1;34m  Daily Calorie Intake:\033[0m " << user.calories << " calories\n";
-            std::cout << "\033[1;33m|\033[0m\n";
-            std::cout << "\033[1;33m|\033[0m" << "\033[1;35m  Carbohydrates:\033[0m        " << user.carbs << " grams\n";
-            std::cout << "\033[1;33m|\033[0m" << "\033[1;35m  Protein:\033[0m              " << user.protein << " grams\n";
-            std::cout << "\033[1;33m|\033[0m" << "\033[1;35m  Fat:\033[0m                  " << user.fat << " grams\n";
-            std::cout << "\033[1;33m=========================================\033[0m\n";
+        void serve(int fd, Connection& connection) {
+            char block[65536];
+            while (connection.in.size() < size_t(maxFrame) + 4) {
+                ssize_t received = ::recv(fd, block, sizeof(block), 0);
+                if (received > 0) { connection.in.append(block, received); continue; }
+                if (received < 0 && errno == EINTR) continue;
+                if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+                closeConnection(fd);
+                return;
+            }
+            answerFrames(fd, connection);
         }
-};
 
+        /** Answers the complete request frames read so far, 'roundSize' requests at a time, and sends the replies
+         * Stops while the reply backlog is over 'maxBacklog'; the remaining frames are answered once the client reads its replies
+         **/
+        void answerFrames(int fd, Connection& connection) {
+            size_t position = 0;
+            while (true) {
+                if (backlogged(connection)) {
+                    if (!flush(fd, connection)) return;
+                    if (backlogged(connection)) break;
+                }
 
-class HealthAssistant {
-    protected:
+                // Split complete frames into requests until the round is full, noting how many each batch frame holds
+                requests.clear();
+                frameSizes.clear();
+                while (requests.size() < roundSize && connection.in.size() - position >= 4) {
+                    uint32_t length = readLength(connection.in.data() + position);
+                    if (length > maxFrame) {
+                        closeConnection(fd);
+                        return;
+                    }
+                    if (connection.in.size() - position - 4 < length) break;
+                    std::string_view payload = std::string_view(connection.in).substr(position + 4, length);
+                    position += 4 + length;
+                    if (payload.substr(0, 6) != "batch\n" && payload != "batch") {
+                        requests.push_back(payload);
+                        frameSizes.push_back(plainFrame);
+                        continue;
+                    }
+                    size_t count = 0;
+                    for (size_t start = 6; start <= payload.size(); ++count) {
+                        size_t end = std::min(payload.find('\n', start), payload.size());
+                        requests.push_back(payload.substr(start, end - start));
+                        start = end + 1;
+                    }
+                    frameSizes.push_back(count);
+                }
+                if (frameSizes.empty()) break;
 
-        /** A static instance of the UserInfoManager 'mymanager' to manage user information
-         * All HealthAssistant instances share the same UserInfoManager instance
-         * This means that all HealthAssistant instances share the same UserInfo vector
-         * Protected since derived classes also use the same UserInfo list
+                // Answer the round's requests at once, then frame the replies in request order
+                answer(requests, replies);
+                size_t next = 0;
+                for (size_t count : frameSizes) {
+                    if (count == plainFrame) {
+                        appendFrame(connection.out, replies[next++]);
+                        continue;
+                    }
+                    size_t total = 1;
+                    for (size_t i = next; i < next + count; ++i) total += 4 + replies[i].size();
+                    if (total > maxFrame) {
+                        appendFrame(connection.out, "-Batch reply is larger than a frame; send fewer requests per batch.");
+                        next += count;
+                        continue;
+                    }
+                    appendLength(connection.out, total);
+                    connection.out += '+';
+                    for (size_t i = next; i < next + count; ++i) appendFrame(connection.out, replies[i]);
+                    next += count;
+                }
+            }
+            connection.in.erase(0, position);
+            flush(fd, connection);
+        }
+
+        /** Answers a list of requests in order, replacing 'replies'
+         * Each run of consecutive lookups is resolved with a single userRows call
          **/
-        static UserInfoManager mymanager;
+        void answer(const std::vector<std::string_view>& requests, std::vector<std::string>& replies) {
+            replies.resize(requests.size());
+            for (size_t i = 0; i < requests.size(); ) {
+                if (requests[i].substr(0, 7) != "lookup ") {
+                    replies[i] = handle(requests[i]);
+                    i++;
+                    continue;
+                }
+                size_t end = i;
+                names.clear();
+                while (end < requests.size() && requests[end].substr(0, 7) == "lookup ") names.push_back(requests[end++].substr(7));
+                ha.userRows(names, rows, found);
+                for (size_t j = 0; j < names.size(); ++j) {
+                    std::string& reply = replies[i + j];
+                    reply.assign(1, found[j] ? '+' : '-');
+                    if (found[j]) reply += rows[j];
+                    else reply.append("User with name ").append(names[j]).append(" does not exist.");
+                }
+                i = end;
+            }
+            for (std::string& reply : replies) {
+                if (reply.size() > maxFrame) reply = "-Reply is larger than a frame; narrow the request.";
+            }
+        }
 
     public:
-
         /** Constructor
-         * Protected to prevent instantiation of the HealthAssistant class directly
-         * The HealthAssistant class on its own has no way to calculate bfp
+         * Binds the socket at 'path', replacing a stale socket file left there by a server that is gone
+         * Throws a runtime error if the socket cannot be created or bound, or if another server is listening at 'path'
          **/
-        HealthAssistant() {mymanager.clearUsers();}
+        QueryServer(HealthAssistant& ha, const std::string& path) : ha(ha), path(path) {
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            if (path.size() >= sizeof(address.sun_path)) {
+                throw std::runtime_error("Socket path " + path + " is too long.");
+            }
+            std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+            removeStaleSocket(address);
+            listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            poller = ::epoll_create1(EPOLL_CLOEXEC);
+            wake = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            ownsPath = listener >= 0 && poller >= 0 && wake >= 0
+                && ::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+            if (!ownsPath || ::listen(listener, SOMAXCONN) != 0) {
+                std::string error = std::strerror(errno);
+                release();
+                throw std::runtime_error("Could not serve on " + path + ": " + error);
+            }
+            watch(listener, EPOLLIN, EPOLL_CTL_ADD);
+            watch(wake, EPOLLIN, EPOLL_CTL_ADD);
+        }
 
         /** Destructor
+         * Closes all connections and removes the socket file
          **/
-        ~HealthAssistant() {}
+        ~QueryServer() { release(); }
 
-        /** Virtual method to calculate body fat percentage
-         * Derived classes must implement this method to calculate body fat percentage
-         * The BFP calculation method is specific to the derived class
-         **/
-        virtual void getBfp(std::string username) = 0;
+        QueryServer(const QueryServer&) = delete;
+        QueryServer& operator=(const QueryServer&) = delete;
 
-        /** Calculates and updates the recommended daily calorie intake for a user based on age and lifestyle
+        /** Serves connections until stop() is called
          **/
-        void getDailyCalories(std::string username){
-            // Get user information from the static UserInfo vector
-            int age = mymanager.getAge(username);
-            std::string gender = mymanager.getGender(username);
-            std::string lifestyle = mymanager.getLifestyle(username);
-
-            // Set base calorie intake then add additional calories based on age and gender
-            int calories = 1600;
-            if (age < 51) { 
-                calories += (age > 30) ? 200 : 400;
+        void run() {
+            epoll_event events[256];
+            while (!stopping.load()) {
+                int ready = ::epoll_wait(poller, events, 256, -1);
+                if (ready < 0) {
+                    if (errno == EINTR) continue;
+                    throw std::runtime_error(std::string("Could not wait for sockets: ") + std::strerror(errno));
+                }
+                for (int i = 0; i < ready; ++i) {
+                    int fd = events[i].data.fd;
+                    if (fd == wake) continue;
+                    if (fd == listener) { acceptAll(); continue; }
+                    auto connection = connections.find(fd);
+                    if (connection == connections.end()) continue;
+                    if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                        serve(fd, connection->second);
+                    } else if (events[i].events & EPOLLIN) {
+                        serve(fd, connection->second);
+                    } else if (events[i].events & EPOLLOUT) {
+                        // Frames held back while the client's replies were backlogged are answered once it has read them
+                        if (flush(fd, connection->second) && !backlogged(connection->second) && !connection->second.in.empty()) {
+                            answerFrames(fd, connection->second);
+                        }
+                    }
+                }
             }
-            calories += (gender == "male") ? 400 : 0;
+        }
 
-            // Set a scaling factor based on activity level
-            int activityBonus = (gender == "male") ? 300 : 200;
+        /** Makes run() return; safe to call from another thread or a signal handler
+         **/
+        void stop() {
+            stopping.store(true);
+            uint64_t one = 1;
+            ssize_t ignored = ::write(wake, &one, sizeof(one));
+            (void)ignored;
+        }
 
-            // Add additional calories based on activity level
-            if (lifestyle != "sedentary") {
-                calories += (lifestyle == "moderate") ? activityBonus : (2*activityBonus);
+        /** Parses the conditions of a "filter" or "define" request, e.g. "gender=male age=40-59 group=high"
+         * Throws an invalid argument error if a condition is not recognized
+         **/
+        static ScanFilter parseFilter(const std::string& conditions) {
+            ScanFilter filter;
+            std::istringstream stream(conditions);
+            std::string condition;
+            while (stream >> condition) {
+                size_t equals = condition.find('=');
+                std::string key = condition.substr(0, equals);
+                std::string value = (equals == std::string::npos) ? "" : condition.substr(equals + 1);
+                if (key == "gender") filter.genders.push_back(value);
+                else if (key == "lifestyle") filter.lifestyles.push_back(value);
+                else if (key == "group") filter.groups.push_back(value);
+                else if (key == "age") {
+                    size_t dash = value.find('-');
+                    filter.minAge = std::stoi(value.substr(0, dash));
+                    filter.maxAge = (dash == std::string::npos) ? filter.minAge : std::stoi(value.substr(dash + 1));
+                }
+                else throw std::invalid_argument("Unknown filter " + key);
             }
+            return filter;
+        }
 
-            // Update the UserInfo object with the calculated calorie intake
-            mymanager.setCalories(username, calories);
+        // Appends usernames to a reply, one per line
+        static void appendLines(std::string& reply, const std::vector<std::string>& usernames) {
+            for (const std::string& username : usernames) {
+                if (reply.size() > 1) reply += '\n';
+                reply += username;
+            }
         }
 
-        /** Calculates and updates the macronutrient breakdown for a user based on their daily calorie intake
+        /** Answers one request payload (see the class comment)
+         * Errors are turned into '-' replies, so a bad request never stops the server
          **/
-        void getMealPrep(std::string username){
-            // Constants for macronutrient calorie values
-            const int carb_calories = 4;
-            const int protein_calories = 4;
-            const int fat_calories = 9;
-
-            // Constants for recommended macronutrient breakdown percentages
-            const double carb_percent = 0.5;
-            const double protein_percent = 0.3;
-            const double fat_percent = 0.2;
-
-            // If the user's daily calorie intake has not been calculated, print an error and return
-            int calories = mymanager.getCalories(username);
-            if (calories == 0) {
-                throw std::runtime_error("A user's daily calorie intake must be calculated before their macronutrient breakdown.");
+        std::string handle(std::string_view request) {
+            size_t space = request.find(' ');
+            std::string_view command = request.substr(0, space);
+            std::string argument(space == std::string_view::npos ? std::string_view() : request.substr(space + 1));
+            std::string reply = "+";
+            try {
+                if (command == "lookup") {
+                    reply += ha.userRow(argument);
+                } else if (command == "filter") {
+                    appendLines(reply, ha.filterUsers(parseFilter(argument)));
+                } else if (command == "define") {
+                    size_t split = argument.find(' ');
+                    ha.createView(argument.substr(0, split), parseFilter(split == std::string::npos ? "" : argument.substr(split + 1)));
+                } else if (command == "view") {
+                    appendLines(reply, ha.viewUsers(argument));
+                } else if (command == "drop") {
+                    ha.dropView(argument);
+                } else if (command == "reclassify") {
+                    BfpThresholds::current().load(argument);
+                    reply += std::to_string(ha.reclassify());
+                } else if (command == "stats") {
+                    // Read from the live aggregates, so polling does not scan the users
+                    const UserInfoManager::LiveStats& live = ha.liveStats();
+                    for (const std::string& gender : UserInfoManager::genderLabels()) {
+                        for (const std::string& group : UserInfoManager::bfpGroupLabels()) {
+                            UserInfoManager::LiveCell cell = live.total(gender, {group});
+                            if (cell.count == 0) continue;
+                            if (reply.size() > 1) reply += '\n';
+                            reply += gender + "," + group + "," + std::to_string(cell.count) + ",";
+                            char mean[32];
+                            reply.append(mean, std::snprintf(mean, sizeof(mean), "%g", cell.bfp / cell.count));
+                        }
+                    }
+                } else if (command == "add") {
+                    ha.addUser(argument);
+                } else if (command == "delete") {
+                    ha.deleteUser(argument);
+                } else if (command == "latency") {
+                    std::ostringstream report;
+                    LatencyRecorder::report(report);
+                    reply += report.str();
+                } else {
+                    throw std::invalid_argument("Unknown request " + std::string(command));
+                }
+            } catch (const std::exception& e) {
+                reply = "-";
+                reply += e.what();
             }
+            return reply;
+        }
 
-            // Calculate grams for each macronutrient and set the user's macronutrient breakdown
-            mymanager.setCarbs(username, (calories * carb_percent) / carb_calories);
-            mymanager.setProtein(username, (calories * protein_percent) / protein_calories);
-            mymanager.setFat(username, (calories * fat_percent) / fat_calories);
-
+        // Appends one frame holding 'payload' to 'out'
+        static void appendFrame(std::string& out, std::string_view payload) {
+            appendLength(out, payload.size());
+            out.append(payload.data(), payload.size());
         }
 
-        /** Overwrites the static UserInfo vector 'mylist' with user information from a .csv file, then updates all users' calculated information
-         * Calculates body fat percentage, daily calorie intake, and macronutrient breakdown for each user
+        /** Appends a frame length as 4 little-endian bytes, whatever the byte order of the host
+         * Throws a runtime error if the length is over the frame limit, since the other end would close the connection
          **/
-        void massLoadAndCompute(std::string filename){
-            // Read user information from the file to populate the static UserInfo vector
-            mymanager.readFromFile(filename);
-            // Iterate UserInfo vector and update each user's body fat percentage, daily calorie intake, and macronutrient breakdown
-            for (std::string username : mymanager.allUsers()) {
-                getBfp(username);
-                getDailyCalories(username);
-                getMealPrep(username);
+        static void appendLength(std::string& out, size_t length) {
+            if (length > maxFrame) {
+                throw std::runtime_error("Frame of " + std::to_string(length) + " bytes is larger than the limit of " + std::to_string(maxFrame) + " bytes.");
             }
+            for (int shift = 0; shift < 32; shift += 8) out += static_cast<char>((length >> shift) & 0xff);
         }
 
-        /** Wrappers for the public UserInfoManager methods
-         **/
-        void getUserDetail() { mymanager.addUserInfo(); }
-        void display(std::string username){ mymanager.display(username); }; 
-        void serialize(std::string filename){ mymanager.writeToFile(filename); }; 
-        void readFromFile(std::string filename){ mymanager.readFromFile(filename);}; 
-        void deleteUser(std::string username){ mymanager.deleteUser(username);}; 
-        std::vector<std::string> healthyUsers(std::string gender){ return mymanager.healthyUsers(gender); };
-        std::vector<std::string> unhealthyUsers(std::string gender){ return mymanager.unhealthyUsers(gender); };
-        std::vector<std::string> allUsers(std::string gender){ return mymanager.allUsers(gender); };
+        // Reads a frame length written by appendLength
+        static uint32_t readLength(const char* data) {
+            uint32_t length = 0;
+            for (int i = 3; i >= 0; --i) length = (length << 8) | static_cast<unsigned char>(data[i]);
+            return length;
+        }
 };
 
-class USNavyMethod : public HealthAssistant {
+
+/** Blocking client of a QueryServer, for scripts and local testing
+ **/
+class QueryClient
+{
     private:
+        int fd=-1;
+        std::string in;
+        std::string out;
 
-        /** Method to get the body fat percentage group based on the user's age and gender
-         *  Returns a string representing the group the user falls into
+    public:
+        /** Constructor
+         * Throws a runtime error if the server cannot be reached
          **/
-        std::string getBfpGroup(double bfp, int age, std::string gender) {
-            std::vector<std::pair<int, std::string>> ranges;
-            // Set the thresholds for bfp group based on age
-            if (gender == "female") {
-                if (age >= 20 && age <= 39) ranges = {{21, "low"}, {33, "normal"}, {39, "high"}};
-                else if (age >= 40 && age <= 59) ranges = {{23, "low"}, {34, "normal"}, {40, "high"}};
-                else if (age >= 60 && age <= 79) ranges = {{24, "low"}, {36, "normal"}, {42, "high"}};
-            } else if (gender == "male") {
-                if (age >= 20 && age <= 39) ranges = {{8, "low"}, {20, "normal"}, {25, "high"}};
-                else if (age >= 40 && age <= 59) ranges = {{11, "low"}, {22, "normal"}, {28, "high"}};
-                else if (age >= 60) ranges = {{13, "low"}, {25, "normal"}, {30, "high"}};
+        explicit QueryClient(const std::string& path) {
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+            fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+                std::string error = std::strerror(errno);
+                if (fd >= 0) ::close(fd);
+                throw std::runtime_error("Could not connect to " + path + ": " + error);
             }
-
-            // Return the group based on the bfp and the thresholds
-            for (auto& range : ranges) {
-                if (bfp < range.first) return range.second;
-            }
-            return "very high";
         }
 
-    public:
-
-        /** Calculates and updates the body fat percentage of a user using the US Navy method
-         * Uses gender, age, waist, neck, hip, and height measurements to calculate body fat percentage
-         **/
-        void getBfp(std::string username) {
-            double bfp;
-            std::string gender = mymanager.getGender(username);
-            int age = mymanager.getAge(username);
-            double waist = mymanager.getWaist(username);
-            double neck = mymanager.getNeck(username);
-            double hip = mymanager.getHip(username);
-            double height = mymanager.getHeight(username);
+        ~QueryClient() { ::close(fd); }
 
-            if (gender == "male") {
-                bfp = 495 / (1.0324 - 0.19077 * log10(waist - neck) + 0.15456 * log10(height)) - 450;
-            } else {
-                bfp = 495 / (1.29579 - 0.35004 * log10(waist + hip - neck) + 0.22100 * log10(height)) - 450;
-            }
+        QueryClient(const QueryClient&) = delete;
+        QueryClient& operator=(const QueryClient&) = delete;
 
-            std::string group = getBfpGroup(bfp, age, gender);
-            mymanager.setBfp(username, {bfp, group});
+        /** Sends one request and waits for its reply (see QueryServer)
+         * Throws a runtime error if the connection fails
+         **/
+        std::string request(std::string_view payload) {
+            send(payload);
+            flush();
+            return receive();
         }
-};
 
-class BmiMethod : public HealthAssistant {
-    private:
-    
-        /** Method to get the body fat percentage group based on the user's bfp
-         *  Returns a string representing the group the user falls into
+        /** Sends several requests in one batch frame and waits for their replies, in order
+         * Throws a runtime error if the connection fails or the server rejects the frame
          **/
-        std::string getBfpGroup(double bfp) {
-            if (bfp < 18.5){ return "underweight"; }
-            else if (bfp < 24.9){ return "healthy weight"; }
-            else if (bfp < 29.9){ return "overweight"; }
-            else { return "obesity"; }
+        std::vector<std::string> batch(const std::vector<std::string>& payloads) {
+            std::string frame = "batch";
+            for (const std::string& payload : payloads) {
+                frame += '\n';
+                frame += payload;
+            }
+            std::string reply = request(frame);
+            if (reply.empty() || reply[0] != '+') {
+                throw std::runtime_error("Batch was rejected: " + reply.substr(std::min<size_t>(1, reply.size())));
+            }
+            std::vector<std::string> replies;
+            for (size_t position = 1; position + 4 <= reply.size(); ) {
+                uint32_t length = QueryServer::readLength(reply.data() + position);
+                replies.push_back(reply.substr(position + 4, length));
+                position += 4 + length;
+            }
+            return replies;
         }
 
-    public:
+        /** Queues one request frame without sending it, so several frames can be in flight at once
+         * Replies arrive in the order the frames were sent
+         **/
+        void send(std::string_view payload) { QueryServer::appendFrame(out, payload); }
 
-        /** Calculates and updates the body fat percentage of a user using the BMI method
-         * Uses weight and height measurements to calculate body fat percentage
-        **/
-        void getBfp (std::string username) {
-            // Get user information from the static UserInfo vector
-            int age = mymanager.getAge(username);
-            std::string gender = mymanager.getGender(username);
-            double weight = mymanager.getWeight(username);
-            double height = mymanager.getHeight(username);
+        /** Sends all queued request frames
+         * Throws a runtime error if the connection fails
+         **/
+        void flush() {
+            for (size_t sent = 0; sent < out.size(); ) {
+                ssize_t written = ::send(fd, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+                if (written < 0 && errno == EINTR) continue;
+                if (written < 0) throw std::runtime_error(std::string("Could not send request: ") + std::strerror(errno));
+                sent += written;
+            }
+            out.clear();
+        }
 
-            // Calculate body fat percentage using the BMI method
-            double bfp = (weight / ((height/100) * (height/100)));
-            std::string group = getBfpGroup(bfp);
-            mymanager.setBfp(username, {bfp, group});
+        /** Waits for the reply to the oldest request frame not yet answered
+         * Throws a runtime error if the connection is closed
+         **/
+        std::string receive() {
+            while (true) {
+                uint32_t length = (in.size() >= 4) ? QueryServer::readLength(in.data()) : 0;
+                if (in.size() >= 4 && in.size() - 4 >= length) {
+                    std::string reply = in.substr(4, length);
+                    in.erase(0, 4 + length);
+                    return reply;
+                }
+                char block[65536];
+                ssize_t received = ::recv(fd, block, sizeof(block), 0);
+                if (received < 0 && errno == EINTR) continue;
+                if (received <= 0) throw std::runtime_error("Connection to the server was closed.");
+                in.append(block, received);
+            }
         }
 };
 
+
 class UserStats {
 
     private:
 
+        // Groups counted as healthy by either method, as in UserInfoManager::healthyUsers
+        inline static const std::vector<std::string> healthyGroups = {"normal", "healthy weight"};
+
         // Struct to store statistics about users
         struct Stats{
             int totalUsers;
@@ -645,6 +4988,9 @@ class UserStats {
 
         // A helper method for GetHealthyUsers which makes FullStats simpler to implement. See GetHealthyUsers for more details.
         std::vector<std::string> HealthyUsers (std::string method, std::string gender="") {
+            TraceSpan span("HealthyUsers", "stats");
+            // Every gender is one unfiltered pass
+            if (gender == "all") gender = "";
             // Vector to store usernames of healthy users
             std::vector<std::string> healthyUsers;
 
@@ -675,7 +5021,11 @@ class UserStats {
                 std::vector<std::string> healthyUsersBmi = ha->healthyUsers(gender);
                 delete ha;
                 
-                healthyUsers.insert(healthyUsers.end(), healthyUsersBmi.begin(), healthyUsersBmi.end());
+                // A user in both data sets is listed once
+                std::unordered_set<std::string> listed(healthyUsers.begin(), healthyUsers.end());
+                for (std::string& username : healthyUsersBmi) {
+                    if (listed.insert(username).second) healthyUsers.push_back(std::move(username));
+                }
             } else {
                 // Handle invalid method
                 throw std::invalid_argument("Invalid bfp method. Must be either 'USNavy', 'bmi', or 'all'.");
@@ -685,11 +5035,13 @@ class UserStats {
 
         /** Gets a vector containing the usernames of all users with a "normal" body fat percentage
          * Uses the US Navy, BMI method, or both to calculate body fat percentage
-         * If using both, returns users with a "normal" body fat percentage from both methods
+         * If using both, returns users with a "normal" body fat percentage from both methods, each user once
+         * A gender of "all" or "" lists users of every gender
          **/
         std::vector<std::string> GetHealthyUsers(std::string method, std::string gender="") {
+            TraceSpan span("GetHealthyUsers", "stats");
             std::vector<std::string> healthyUsers = HealthyUsers(method, gender);
-            if (gender == ""){ gender = "male or female"; };
+            if (gender == "" || gender == "all"){ gender = "male or female"; };
             if (method == "all") { method = "USNavy and bmi"; };
             std::cout << "Healthy users (gender: " << gender << ") according to the " << method <<" method: ";
             for (size_t i = 0; i < healthyUsers.size(); ++i) {
@@ -704,6 +5056,9 @@ class UserStats {
 
          // A helper method for GetUnfitUsers which makes FullStats simpler to implement. See GetUnfitUsers for more details.
         std::vector<std::string> UnfitUsers(std::string method, std::string gender = "") {
+            TraceSpan span("UnfitUsers", "stats");
+            // Every gender is one unfiltered pass
+            if (gender == "all") gender = "";
             // Vector to store usernames of unfit users
             std::vector<std::string> unfitUsers;
 
@@ -726,7 +5081,7 @@ class UserStats {
             } else if (method == "all") {
                 ha = new USNavyMethod();
                 ha->massLoadAndCompute("us_user_data.csv");
-                std::vector<std::string> unfitUsers = ha->unhealthyUsers(gender);
+                unfitUsers = ha->unhealthyUsers(gender);
                 delete ha;
                 
                 ha = new BmiMethod();
@@ -734,7 +5089,11 @@ class UserStats {
                 std::vector<std::string> unfitUsersBmi = ha->unhealthyUsers(gender);
                 delete ha;
                 
-                unfitUsers.insert(unfitUsers.end(), unfitUsersBmi.begin(), unfitUsersBmi.end());
+                // A user in both data sets is listed once
+                std::unordered_set<std::string> listed(unfitUsers.begin(), unfitUsers.end());
+                for (std::string& username : unfitUsersBmi) {
+                    if (listed.insert(username).second) unfitUsers.push_back(std::move(username));
+                }
             } else {
                 // Handle invalid method
                 throw std::invalid_argument("Invalid bfp method. Must be either 'USNavy', 'bmi', or 'all'.");
@@ -744,11 +5103,13 @@ class UserStats {
 
         /** Gets a vector containing the usernames of all users with a "normal" body fat percentage
          * Uses the US Navy, BMI method, or both to calculate body fat percentage
-         * If using both, returns users with a "normal" body fat percentage from both methods
+         * If using both, returns users with a "normal" body fat percentage from both methods, each user once
+         * A gender of "all" or "" lists users of every gender
          **/
         std::vector<std::string> GetUnfitUsers(std::string method, std::string gender="") {
+            TraceSpan span("GetUnfitUsers", "stats");
             std::vector<std::string> unfitUsers = UnfitUsers(method, gender);
-            if (gender == ""){ gender = "male or female"; };
+            if (gender == "" || gender == "all"){ gender = "male or female"; };
             if (method == "all") { method = "USNavy and bmi"; };
             std::cout << "Unfit users (gender: " << gender << ") according to the " << method <<" method: ";
             for (size_t i = 0; i < unfitUsers.size(); ++i) {
@@ -761,28 +5122,196 @@ class UserStats {
             return unfitUsers;
         }
 
+        /** Gets and displays aggregate statistics grouped by the given keys (see UserInfoManager::groupBy)
+         * Uses the US Navy, BMI method, or both to calculate body fat percentage
+         * If using both, the "method" key is always added so groups from the two methods stay apart
+         **/
+        std::vector<UserInfoManager::GroupStats> GetGroupedStats(std::string method, std::vector<std::string> keys) {
+            TraceSpan span("GetGroupedStats", "stats");
+            std::vector<UserInfoManager::GroupStats> groups;
+            std::unique_ptr<HealthAssistant> ha;
+
+            if (method == "USNavy"){
+                ha.reset(new USNavyMethod());
+                ha->massLoadAndCompute("us_user_data.csv");
+                groups = ha->groupBy(keys);
+
+            } else if (method == "bmi"){
+                ha.reset(new BmiMethod());
+                ha->massLoadAndCompute("bmi_user_data.csv");
+                groups = ha->groupBy(keys);
+
+            } else if (method == "all") {
+                if (std::find(keys.begin(), keys.end(), "method") == keys.end()) {
+                    keys.push_back("method");
+                }
+                ha.reset(new USNavyMethod());
+                ha->massLoadAndCompute("us_user_data.csv");
+                groups = ha->groupBy(keys);
+
+                ha.reset(new BmiMethod());
+                ha->massLoadAndCompute("bmi_user_data.csv");
+                std::vector<UserInfoManager::GroupStats> groupsBmi = ha->groupBy(keys);
+
+                groups.insert(groups.end(), groupsBmi.begin(), groupsBmi.end());
+            } else {
+                // Handle invalid method
+                throw std::invalid_argument("Invalid bfp method. Must be either 'USNavy', 'bmi', or 'all'.");
+            }
+
+            // Display one line per group
+            std::cout << "\nGrouped statistics (age, gender, lifestyle, group, method: count | mean/min/max/variance):\n";
+            for (const UserInfoManager::GroupStats& group : groups) {
+                std::cout << group.ageBand << ", " << group.gender << ", " << group.lifestyle << ", " << group.group << ", " << group.method
+                          << ": " << group.count << " users" << std::fixed << std::setprecision(1)
+                          << " | bfp " << group.bfp.mean << "/" << group.bfp.min << "/" << group.bfp.max << "/" << group.bfp.variance()
+                          << " | calories " << group.calories.mean << "/" << group.calories.min << "/" << group.calories.max << "/" << group.calories.variance()
+                          << " | carbs " << group.carbs.mean << "/" << group.carbs.min << "/" << group.carbs.max << "/" << group.carbs.variance()
+                          << " | protein " << group.protein.mean << "/" << group.protein.min << "/" << group.protein.max << "/" << group.protein.variance()
+                          << " | fat " << group.fat.mean << "/" << group.fat.min << "/" << group.fat.max << "/" << group.fat.variance()
+                          << std::endl;
+            }
+            return groups;
+        }
+
+        /** Gets and displays the p50, p90 and p99 of a numeric field for a cohort
+         * Uses the US Navy or BMI method to calculate body fat percentage
+         * If 'approximate' is set, the percentiles come from a quantile sketch instead of an exact selection
+         **/
+        std::vector<double> GetPercentiles(std::string method, std::string field, std::string gender="", std::string ageBand="", bool approximate=false) {
+            TraceSpan span("GetPercentiles", "stats");
+            std::unique_ptr<HealthAssistant> ha;
+            if (method == "USNavy"){
+                ha.reset(new USNavyMethod());
+                ha->massLoadAndCompute("us_user_data.csv");
+            } else if (method == "bmi"){
+                ha.reset(new BmiMethod());
+                ha->massLoadAndCompute("bmi_user_data.csv");
+            } else {
+                // Handle invalid method
+                throw std::invalid_argument("Invalid bfp method. Must be either 'USNavy' or 'bmi'.");
+            }
+
+            std::vector<double> ps = { 50, 90, 99 };
+            std::vector<double> values;
+            if (approximate) {
+                QuantileSketch sketch = ha->sketch(field, gender, ageBand);
+                for (double p : ps) values.push_back(sketch.quantile(p));
+            } else {
+                values = ha->percentiles(field, ps, gender, ageBand);
+            }
+
+            if (gender == ""){ gender = "male or female"; };
+            if (ageBand == ""){ ageBand = "all ages"; };
+            std::cout << "Percentiles of " << field << " (gender: " << gender << ", age: " << ageBand << ") according to the " << method << " method: "
+                      << "p50 = " << values[0] << ", p90 = " << values[1] << ", p99 = " << values[2] << std::endl;
+            return values;
+        }
+
+        /** Gets and displays the 'k' users with the highest value of a numeric field
+         * Uses the US Navy or BMI method to calculate body fat percentage
+         **/
+        std::vector<std::pair<std::string, double>> GetTopUsers(std::string method, std::string field, size_t k) {
+            TraceSpan span("GetTopUsers", "stats");
+            std::unique_ptr<HealthAssistant> ha;
+            if (method == "USNavy"){
+                ha.reset(new USNavyMethod());
+                ha->massLoadAndCompute("us_user_data.csv");
+            } else if (method == "bmi"){
+                ha.reset(new BmiMethod());
+                ha->massLoadAndCompute("bmi_user_data.csv");
+            } else {
+                // Handle invalid method
+                throw std::invalid_argument("Invalid bfp method. Must be either 'USNavy' or 'bmi'.");
+            }
+            std::vector<std::pair<std::string, double>> top = ha->topUsers(field, k);
+
+            std::cout << "Top " << k << " users by " << field << " according to the " << method << " method: ";
+            for (size_t i = 0; i < top.size(); ++i) {
+                std::cout << top[i].first << " (" << top[i].second << ")";
+                if (i != top.size() - 1) {
+                    std::cout << ", ";
+                }
+            }
+            std::cout << std::endl;
+            return top;
+        }
+
+        /** Gets and displays how the US Navy and BMI methods compare on one population
+         * Loads the file once and evaluates both methods in a single pass (see CombinedMethod)
+         **/
+        UserInfoManager::MethodComparison GetMethodComparison(std::string filename="users.csv") {
+            TraceSpan span("GetMethodComparison", "stats");
+            std::unique_ptr<HealthAssistant> ha(new CombinedMethod());
+            ha->massLoadAndCompute(filename);
+            UserInfoManager::MethodComparison comparison = ha->compareMethods();
+
+            long long total = comparison.totalMale + comparison.totalFemale;
+            std::cout << "\nMethod comparison for " << filename << " (" << total << " users):" << std::endl;
+            std::cout << "Healthy males: US Navy " << comparison.healthyUsNavyMale << ", BMI " << comparison.healthyBmiMale << " of " << comparison.totalMale << std::endl;
+            std::cout << "Healthy females: US Navy " << comparison.healthyUsNavyFemale << ", BMI " << comparison.healthyBmiFemale << " of " << comparison.totalFemale << std::endl;
+            std::cout << "Users classified the same by both methods: " << comparison.agree << "/" << total << std::endl;
+            return comparison;
+        }
+
+        /** Gets and displays a per-user comparison of the users present in both the US Navy and BMI data sets
+         * Users are matched by name with a hash join, so each user is counted once
+         * Also reports users whose health class differs between the methods, e.g. healthy under BMI but high under US Navy
+         **/
+        UserInfoManager::JoinResult CompareDatasets(std::string usFile="us_user_data.csv", std::string bmiFile="bmi_user_data.csv") {
+            TraceSpan span("CompareDatasets", "stats");
+            // Load the US Navy data set and keep it aside while the BMI data set is loaded
+            std::unique_ptr<HealthAssistant> ha(new USNavyMethod());
+            ha->massLoadAndCompute(usFile);
+            UserInfoManager usUsers = ha->releaseUsers();
+
+            ha.reset(new BmiMethod());
+            ha->massLoadAndCompute(bmiFile);
+            UserInfoManager::JoinResult joined = usUsers.joinByName(ha->releaseUsers());
+
+            std::cout << "\nUsers in both " << usFile << " and " << bmiFile << ": " << joined.users.size() << std::endl;
+            for (const UserInfoManager::JoinedUser& user : joined.users) {
+                std::cout << user.name << " (" << user.gender << ", " << user.age << "): US Navy " << user.bfp.first << "%, " << user.bfp.second
+                          << " | BMI " << user.otherBfp.first << ", " << user.otherBfp.second << std::endl;
+            }
+            std::cout << "Disagreements between the methods:" << std::endl;
+            for (int usNavy = 0; usNavy < 4; ++usNavy) {
+                for (int bmi = 0; bmi < 4; ++bmi) {
+                    if (joined.disagreements[usNavy][bmi] > 0) {
+                        std::cout << UserInfoManager::healthClasses[bmi] << " under BMI but " << UserInfoManager::healthClasses[usNavy]
+                                  << " under US Navy: " << joined.disagreements[usNavy][bmi] << std::endl;
+                    }
+                }
+            }
+            return joined;
+        }
+
         void GetFullStats() {
+            TraceSpan span("GetFullStats", "stats");
             Stats stat;
 
             // Initialize a USNavyMethod HeathAssistant object
             HealthAssistant* ha = new USNavyMethod();
-            // Use GetHealthyUsers to calculate user statistics without displaying information
-            stat.healthyUsNavyMale = HealthyUsers("USNavy", "male").size();
-            stat.healthyUsNavyFemale = HealthyUsers("USNavy", "female").size();
+            // Load each file once; the counts are read from the live aggregates kept while loading
+            ha->massLoadAndCompute("us_user_data.csv");
+            stat.healthyUsNavyMale = ha->liveStats().total("male", healthyGroups).count;
+            stat.healthyUsNavyFemale = ha->liveStats().total("female", healthyGroups).count;
             stat.healthyUsNavy = stat.healthyUsNavyMale + stat.healthyUsNavyFemale;
-            stat.totalUsNavyMale =ha->allUsers("male").size();
-            stat.totalUsNavyFemale = ha->allUsers("female").size();
+            stat.totalUsNavyMale = ha->liveStats().total("male").count;
+            stat.totalUsNavyFemale = ha->liveStats().total("female").count;
             stat.totalUsNavy = stat.totalUsNavyMale + stat.totalUsNavyFemale;
+            delete ha;
 
             // Initialize a BmiMethod HealthAssistant object
             ha = new BmiMethod();
-            // Use HealthyUsers to calculate user statistics without displaying information
-            stat.healthyBmiMale = HealthyUsers("bmi", "male").size();
-            stat.healthyBmiFemale = HealthyUsers("bmi", "female").size();
+            ha->massLoadAndCompute("bmi_user_data.csv");
+            stat.healthyBmiMale = ha->liveStats().total("male", healthyGroups).count;
+            stat.healthyBmiFemale = ha->liveStats().total("female", healthyGroups).count;
             stat.healthyBmi = stat.healthyBmiMale + stat.healthyBmiFemale;
-            stat.totalBmiMale = ha->allUsers("male").size();
-            stat.totalBmiFemale = ha->allUsers("female").size();
+            stat.totalBmiMale = ha->liveStats().total("male").count;
+            stat.totalBmiFemale = ha->liveStats().total("female").count;
             stat.totalBmi = stat.totalBmiMale + stat.totalBmiFemale;
+            delete ha;
 
 
             // Count the number of total users
@@ -794,6 +5323,53 @@ class UserStats {
             displayStats(stat);
         }
 
+        /** Displays the statistics of the users loaded in 'ha', read from the live aggregates without scanning the users
+         * Cheap enough to call after every change, e.g. from a dashboard that polls continuously
+         **/
+        void GetLiveStats(HealthAssistant& ha) {
+            TraceSpan span("GetLiveStats", "stats");
+            const UserInfoManager::LiveStats& live = ha.liveStats();
+            UserInfoManager::LiveCell all = live.total("");
+            std::cout << "\nLive users: " << all.count << std::endl;
+            for (std::string method : {"USNavy", "bmi"}) {
+                for (std::string gender : {"male", "female"}) {
+                    UserInfoManager::LiveCell total = live.methodTotal(gender, method);
+                    if (total.count == 0) continue;
+                    UserInfoManager::LiveCell healthy = live.total(gender, {method == "USNavy" ? "normal" : "healthy weight"});
+                    std::cout << method << " " << gender << ": " << total.count << " users, " << healthy.count << " healthy"
+                        << std::fixed << std::setprecision(1) << ", mean bfp " << total.bfp / total.count
+                        << ", mean calories " << total.calories / total.count << std::endl;
+                }
+            }
+        }
+
+        /** Displays the user statistics of an out-of-core store, computed chunk by chunk
+         * The store holds one population, so the statistics of the method that was not used to compute it are zero
+         **/
+        void GetFullStats(ChunkedUserStore& store) {
+            TraceSpan span("GetFullStats", "stats");
+            Stats stat = {};
+            for (const UserInfoManager::GroupStats& group : store.groupBy({"gender", "group", "method"})) {
+                bool male = group.gender == "male";
+                bool healthy = group.group == "normal" || group.group == "healthy weight";
+                int count = static_cast<int>(group.count);
+                (male ? stat.totalMale : stat.totalFemale) += count;
+                if (group.method == "USNavy") {
+                    (male ? stat.totalUsNavyMale : stat.totalUsNavyFemale) += count;
+                    if (healthy) (male ? stat.healthyUsNavyMale : stat.healthyUsNavyFemale) += count;
+                } else if (group.method == "bmi") {
+                    (male ? stat.totalBmiMale : stat.totalBmiFemale) += count;
+                    if (healthy) (male ? stat.healthyBmiMale : stat.healthyBmiFemale) += count;
+                }
+            }
+            stat.totalUsers = stat.totalMale + stat.totalFemale;
+            stat.totalUsNavy = stat.totalUsNavyMale + stat.totalUsNavyFemale;
+            stat.healthyUsNavy = stat.healthyUsNavyMale + stat.healthyUsNavyFemale;
+            stat.totalBmi = stat.totalBmiMale + stat.totalBmiFemale;
+            stat.healthyBmi = stat.healthyBmiMale + stat.healthyBmiFemale;
+            displayStats(stat);
+        }
+
         // Helper method to calculate percentages and display user statistics
         void displayStats(Stats stat) {
             std::cout << "\nTotal number of users: " << stat.totalUsers << std::endl;
@@ -811,11 +5387,181 @@ class UserStats {
 
 };
 
+// Lookup table of daily calories and macros, computed at compile time
+constexpr std::array<HealthAssistant::Nutrition, 18> HealthAssistant::nutritionTable = HealthAssistant::makeNutritionTable();
+
 // Static instance of UserInfoManager to manage user information
 UserInfoManager HealthAssistant::mymanager = UserInfoManager();
 
-// Main function
-int main() {
+// Server stopped by SIGINT and SIGTERM while "--serve" runs
+static QueryServer* activeServer = nullptr;
+
+/** Runs one non-interactive command given on the command line
+ * "--display <file.csv> [--offset N] [--limit N] [--plain]" prints the users of a file, optionally paged and as a plain table
+ * "--compute <in.csv> <out.csv> [--bmi] [--batch N] [--latency]" calculates the users of a file through the pipeline and prints its stage metrics
+ * "--serve <file.csv> <socket> [--bmi] [--latency]" calculates the users of a file and serves queries on them until interrupted (see QueryServer)
+ * "--latency" records the latency of every operation and prints the latency report at the end (see LatencyRecorder)
+ * "--reclassify <in.csv> <out.csv>" re-buckets the stored bfp of a calculated file into the current groups without recomputing
+ * "--stats" prints the user statistics of us_user_data.csv and bmi_user_data.csv (see UserStats::GetFullStats)
+ * "--trace <file.json>" may be added to any command to write a Chrome trace of its run (see TraceRecorder)
+ * "--allocations" may be added to any command to print its allocations per operation at the end (see AllocationTracker)
+ * "--thresholds <file>" may be added to any command to load the bfp group thresholds from a config file first (see BfpThresholds)
+ * "--query <socket> <request> [--repeat N [--batch B] [--depth D]]" sends a request to a server and prints the reply,
+ *   or repeats it N times in rounds of D frames of B requests and prints the throughput and round trip latencies
+ * Returns the process exit code
+ **/
+int runCommand(const std::vector<std::string>& args) {
+    try {
+        auto trace = std::find(args.begin(), args.end(), "--trace");
+        if (trace != args.end() && trace + 1 != args.end()) {
+            std::vector<std::string> command(args.begin(), trace);
+            command.insert(command.end(), trace + 2, args.end());
+            TraceRecorder::enable(true);
+            int status = runCommand(command);
+            TraceRecorder::enable(false);
+            TraceRecorder::write(*(trace + 1));
+            return status;
+        }
+        auto allocations = std::find(args.begin(), args.end(), "--allocations");
+        if (allocations != args.end()) {
+            std::vector<std::string> command(args.begin(), allocations);
+            command.insert(command.end(), allocations + 1, args.end());
+            AllocationTracker::enable(true);
+            int status = runCommand(command);
+            AllocationTracker::enable(false);
+            AllocationTracker::report(std::cout);
+            return status;
+        }
+        if (args.empty()) {
+            throw std::invalid_argument("No command given");
+        }
+        auto thresholds = std::find(args.begin(), args.end(), "--thresholds");
+        if (thresholds != args.end() && thresholds + 1 != args.end()) {
+            std::vector<std::string> command(args.begin(), thresholds);
+            command.insert(command.end(), thresholds + 2, args.end());
+            BfpThresholds::current().load(*(thresholds + 1));
+            return runCommand(command);
+        }
+        if (args[0] == "--reclassify" && args.size() == 3) {
+            std::unique_ptr<HealthAssistant> ha(new USNavyMethod());
+            ha->readFromFile(args[1]);
+            size_t changed = ha->reclassify();
+            ha->serialize(args[2]);
+            std::cout << "Reclassified " << changed << " users" << std::endl;
+            return 0;
+        }
+        if (args[0] == "--stats" && args.size() == 1) {
+            UserStats stats;
+            stats.GetFullStats();
+            return 0;
+        }
+        if (args[0] == "--compute" && args.size() >= 3) {
+            bool bmi = false;
+            size_t batchSize = 4096;
+            for (size_t i = 3; i < args.size(); ++i) {
+                if (args[i] == "--bmi") bmi = true;
+                else if (args[i] == "--latency") LatencyRecorder::enable(true);
+                else if (args[i] == "--batch" && i + 1 < args.size()) batchSize = std::stoull(args[++i]);
+                else throw std::invalid_argument("Unknown option " + args[i]);
+            }
+            std::unique_ptr<HealthAssistant> ha(bmi ? static_cast<HealthAssistant*>(new BmiMethod()) : new USNavyMethod());
+            HealthAssistant::PipelineMetrics metrics = ha->computeFile(args[1], args[2], batchSize);
+            for (const HealthAssistant::PipelineMetrics::Stage& stage : metrics.stages) {
+                std::cout << std::left << std::setw(8) << stage.name << " batches: " << stage.batches << ", busy: " << std::fixed << std::setprecision(3) << stage.busySeconds << "s" << std::endl;
+            }
+            auto queue = [](const char* name, const SpscRing<UserInfoManager>::Metrics& metrics) {
+                std::cout << std::left << std::setw(8) << name << " queue: " << std::fixed << std::setprecision(2) << metrics.averageOccupancy << "/" << metrics.capacity
+                          << " full, " << metrics.fullWaits << " producer waits, " << metrics.emptyWaits << " consumer waits" << std::endl;
+            };
+            queue("compute", metrics.computeQueue);
+            queue("write", metrics.writeQueue);
+            if (LatencyRecorder::isEnabled()) LatencyRecorder::report(std::cout);
+            return 0;
+        }
+        if (args[0] == "--serve" && args.size() >= 3) {
+            bool bmi = false, latency = false;
+            for (size_t i = 3; i < args.size(); ++i) {
+                if (args[i] == "--bmi") bmi = true;
+                else if (args[i] == "--latency") latency = true;
+                else throw std::invalid_argument("Unknown option " + args[i]);
+            }
+            LatencyRecorder::enable(latency);
+            std::unique_ptr<HealthAssistant> ha(bmi ? static_cast<HealthAssistant*>(new BmiMethod()) : new USNavyMethod());
+            ha->massLoadAndCompute(args[1]);
+            QueryServer server(*ha, args[2]);
+            activeServer = &server;
+            std::signal(SIGINT, [](int) { activeServer->stop(); });
+            std::signal(SIGTERM, [](int) { activeServer->stop(); });
+            std::cout << "Serving " << ha->allUsers("").size() << " users on " << args[2] << std::endl;
+            server.run();
+            activeServer = nullptr;
+            if (latency) LatencyRecorder::report(std::cout);
+            return 0;
+        }
+        if (args[0] == "--query" && args.size() >= 3) {
+            QueryClient client(args[1]);
+            size_t repeats = 0, batchSize = 1, depth = 1;
+            for (size_t i = 3; i < args.size(); ++i) {
+                if (args[i] == "--repeat" && i + 1 < args.size()) repeats = std::stoull(args[++i]);
+                else if (args[i] == "--batch" && i + 1 < args.size()) batchSize = std::max<size_t>(1, std::stoull(args[++i]));
+                else if (args[i] == "--depth" && i + 1 < args.size()) depth = std::max<size_t>(1, std::stoull(args[++i]));
+                else throw std::invalid_argument("Unknown option " + args[i]);
+            }
+            if (repeats == 0) {
+                std::string reply = client.request(args[2]);
+                (reply[0] == '+' ? std::cout : std::cerr) << reply.substr(1) << std::endl;
+                return reply[0] == '+' ? 0 : 1;
+            }
+            // Send rounds of 'depth' frames of 'batchSize' requests each, and time each round trip
+            std::string frame = args[2];
+            if (batchSize > 1) {
+                frame = "batch";
+                for (size_t i = 0; i < batchSize; ++i) frame += "\n" + args[2];
+            }
+            std::vector<double> latencies;
+            size_t sent = 0;
+            auto start = std::chrono::steady_clock::now();
+            while (sent < repeats) {
+                auto round = std::chrono::steady_clock::now();
+                for (size_t i = 0; i < depth; ++i) client.send(frame);
+                client.flush();
+                for (size_t i = 0; i < depth; ++i) client.receive();
+                latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - round).count());
+                sent += depth * batchSize;
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::sort(latencies.begin(), latencies.end());
+            std::cout << std::fixed << std::setprecision(1) << sent / seconds << " requests/s, round trip p50 " << latencies[latencies.size() / 2]
+                      << "us, p99 " << latencies[latencies.size() * 99 / 100] << "us, max " << latencies.back() << "us" << std::endl;
+            return 0;
+        }
+        if (args[0] == "--display" && args.size() >= 2) {
+            size_t offset = 0;
+            size_t limit = std::numeric_limits<size_t>::max();
+            std::string format = "card";
+            for (size_t i = 2; i < args.size(); ++i) {
+                if (args[i] == "--offset" && i + 1 < args.size()) offset = std::stoull(args[++i]);
+                else if (args[i] == "--limit" && i + 1 < args.size()) limit = std::stoull(args[++i]);
+                else if (args[i] == "--plain") format = "table";
+                else throw std::invalid_argument("Unknown option " + args[i]);
+            }
+            UserInfoManager manager;
+            manager.readFromFile(args[1]);
+            manager.displayPage(offset, limit, format);
+            return 0;
+        }
+        throw std::invalid_argument("Usage: --display <file.csv> [--offset N] [--limit N] [--plain] | --compute <in.csv> <out.csv> [--bmi] [--batch N] [--latency] | --serve <file.csv> <socket> [--bmi] [--latency] | --query <socket> <request> [--repeat N [--batch B] [--depth D]] | --reclassify <in.csv> <out.csv> | --stats; any command may add --trace <file.json>, --allocations and --thresholds <file>");
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+}
+
+/**
+ * Runs the interactive demo: reads users from standard input until "exit", then walks through the other operations
+ * Returns the process exit code
+ **/
+int runDemo() {
     HealthAssistant* ha = new USNavyMethod();
     std::string userInput;
 
@@ -874,4 +5620,17 @@ int main() {
     stat.GetHealthyUsers("all");
     stat.GetUnfitUsers("USNavy", "male");
     stat.GetFullStats();
-}
\ No newline at end of file
+    return 0;
+}
+
+// Main function
+// With command-line arguments, runs a single command (see runCommand); otherwise runs the interactive demo
+// Defining HEALTH_ASSISTANT_NO_MAIN leaves it out, so tests can include this file and call the functions above
+#ifndef HEALTH_ASSISTANT_NO_MAIN
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        return runCommand(std::vector<std::string>(argv + 1, argv + argc));
+    }
+    return runDemo();
+}
+#endif
@@ -0,0 +1,81 @@
+// Regression tests for the input fingerprints (see HealthAssistant::massLoadAndCompute)
+// Build and run: g++ -std=c++17 -O2 -pthread fingerprint_test.cpp -o fingerprint_test && ./fingerprint_test
+#define HEALTH_ASSISTANT_NO_MAIN
+#include "assignment3.cpp"
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& message) {
+    if (!condition) {
+        std::cerr << "FAILED: " << message << std::endl;
+        failures++;
+    }
+}
+
+static std::string readAll(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+// Reclassifying a calculated file, or loading it under other thresholds, leaves no user to recalculate
+static void reclassifyKeepsResults(const std::string& directory) {
+    std::string input = directory + "/users.csv";
+    std::string calculated = directory + "/calculated.csv";
+    std::string reclassified = directory + "/reclassified.csv";
+    std::string reloaded = directory + "/reloaded.csv";
+    std::string config = directory + "/thresholds.cfg";
+    {
+        std::ofstream file(input);
+        file << "name,gender,age,weight,waist,neck,height,hip,lifestyle\n";
+        for (int i = 0; i < 200; ++i) {
+            bool female = i % 2 == 0;
+            file << "user" << i << "," << (female ? "female" : "male") << "," << 20 + i % 60 << "," << 50 + i % 40 << ","
+                 << 65 + i % 35 << "," << 30 + i % 9 << "," << 155 + i % 40 << "," << (female ? 85 + i % 30 : 0) << ",active\n";
+        }
+    }
+    {
+        std::ofstream file(config);
+        for (const char* gender : { "female", "male" }) {
+            for (const char* band : { "20-39", "40-59", "60-79" }) file << "USNavy," << gender << "," << band << ",15,25,30\n";
+        }
+    }
+
+    USNavyMethod ha;
+    ha.massLoadAndCompute(input);
+    ha.serialize(calculated);
+
+    BfpThresholds defaults = BfpThresholds::current();
+    BfpThresholds::current().load(config);
+    ha.readFromFile(calculated);
+    check(ha.reclassify() > 0, "the new thresholds moved no user, so the test proves nothing");
+    ha.serialize(reclassified);
+
+    // The salt a recompute under the new thresholds would use
+    uint64_t salt = ha.fingerprintSalt();
+    UserInfoManager users;
+    users.readFromFile(reclassified);
+    check(users.staleUsers(salt).empty(), "users were recalculated after a reclassify");
+    users.readFromFile(calculated);
+    check(users.staleUsers(salt).empty(), "users were recalculated after the thresholds changed");
+
+    // A file calculated under the old thresholds is loaded into the new groups, as if it had been reclassified
+    ha.massLoadAndCompute(calculated);
+    ha.serialize(reloaded);
+    check(readAll(reloaded) == readAll(reclassified), "loading under new thresholds did not re-bucket the stored results");
+
+    BfpThresholds::current() = defaults;
+}
+
+int main() {
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "health_assistant_fingerprint_test";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    reclassifyKeepsResults(directory.string());
+
+    std::filesystem::remove_all(directory);
+    if (failures == 0) std::cout << "All fingerprint tests passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,96 @@
+// Regression tests for the mutation journal (see UserInfoManager::openJournal)
+// Build and run: g++ -std=c++17 -O2 -pthread journal_test.cpp -o journal_test && ./journal_test
+#define HEALTH_ASSISTANT_NO_MAIN
+#include "assignment3.cpp"
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& message) {
+    if (!condition) {
+        std::cerr << "FAILED: " << message << std::endl;
+        failures++;
+    }
+}
+
+static std::string readAll(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+// A torn last record is skipped on replay and cut off, so the next record starts on its own line
+static void tornTail(const std::string& directory) {
+    std::string snapshot = directory + "/snapshot.csv";
+    std::string journalFile = directory + "/journal.log";
+    USNavyMethod ha;
+    ha.openJournal(snapshot, journalFile, 1);
+    ha.addUser("alice,female,30,60,70,32,165,95,active");
+    ha.commitJournal();
+    std::string complete = readAll(journalFile);
+
+    // Simulate a crash in the middle of writing the next record
+    {
+        std::ofstream journal(journalFile, std::ios::binary | std::ios::app);
+        journal << "add,bob,male,4";
+    }
+
+    ha.openJournal(snapshot, journalFile, 1);
+    check(ha.allUsers("").size() == 1, "torn record was replayed");
+    check(readAll(journalFile) == complete, "torn record was not cut off the journal");
+
+    ha.addUser("carl,male,40,80,90,38,180,0,moderate");
+    ha.commitJournal();
+    try {
+        ha.openJournal(snapshot, journalFile, 1);
+        check(ha.allUsers("").size() == 2, "records after the torn one were not replayed");
+    } catch (const std::exception& e) {
+        check(false, std::string("reopening after a torn record threw: ") + e.what());
+    }
+}
+
+// Deleting a later user among several sharing a name replays onto that same user
+static void duplicateNames(const std::string& directory) {
+    std::string snapshot = directory + "/duplicates.csv";
+    std::string journalFile = directory + "/duplicates.log";
+    {
+        std::ofstream file(snapshot);
+        file << "name,gender,age,weight,waist,neck,height,hip,bfp,group,calories,carbs,protein,fat,lifestyle,fingerprint\n";
+        for (int age : { 30, 40, 50 }) {
+            file << "ann,female," << age << ",60,70,32,165,95,24,normal,2400,300,180,53,active,\n";
+        }
+        file << "bob,male,40,80,90,38,180,0,18,normal,2800,350,210,62,moderate,\n";
+    }
+    auto aged = [](int age) {
+        ScanFilter filter;
+        filter.minAge = filter.maxAge = age;
+        return filter;
+    };
+
+    USNavyMethod ha;
+    ha.openJournal(snapshot, journalFile, 1);
+    ha.deleteWhere([](const auto& user) { return user.age == 40 && user.gender == "female"; });
+    ha.openJournal(snapshot, journalFile, 1);
+    check(ha.filterUsers(aged(30)).size() == 1, "the first ann was deleted on replay");
+    check(ha.filterUsers(aged(40)).size() == 1, "the second ann survived replay");
+
+    // The index moves on to the next ann once the first is deleted
+    ha.deleteUser("ann");
+    std::vector<std::string> rows;
+    std::vector<bool> found;
+    ha.userRows({ "ann" }, rows, found);
+    check(found[0] && rows[0].find(",50,") != std::string::npos, "the name index did not move on to the last ann");
+}
+
+int main() {
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "health_assistant_journal_test";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    tornTail(directory.string());
+    duplicateNames(directory.string());
+
+    std::filesystem::remove_all(directory);
+    if (failures == 0) std::cout << "All journal tests passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}